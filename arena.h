@@ -0,0 +1,170 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "fixed_pool.h"
+
+#ifndef ARENA_CHUNK_SIZE
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#endif
+
+constexpr size_t kDefaultArenaChunkSize = ARENA_CHUNK_SIZE;
+
+namespace pool {
+// Bump-pointer allocator for objects of any type which all die together, e.g.
+// the scratch objects of a single request:
+//   pool::Arena arena;
+//   auto *a = arena.New<MyObj>(...);
+//   auto *b = arena.New<OtherObj>(...);
+//   arena.Reset(); // Destroys `b` then `a`, keeps the chunks for reuse.
+//
+// Chunks come from `FixedPool::AllocateChunk`, an allocation only moves a
+// pointer forward. Only objects which aren't trivially destructible get a
+// destructor record, it is bump-allocated right before the object and linked
+// into a list `Reset()` walks newest first. Allocations that don't fit an
+// empty chunk get a chunk of their own, freed by the next `Reset()`.
+//
+// Not thread-safe, an arena belongs to whoever is handling the request.
+class Arena {
+private:
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+
+  struct Destructor {
+    void (*destroy)(void *);
+    void *object;
+    Destructor *prev;
+  };
+
+  // Addresses are never masked, a chunk only needs the alignment plain
+  // `operator new` gives, bigger alignments are padded in the chunk.
+  static constexpr size_t kChunkAlignment = alignof(std::max_align_t);
+
+  size_t chunk_size_;
+  ChunkBacking backing_;
+  uintptr_t cur_ = 0; // Next free byte of `current_`
+  uintptr_t end_ = 0; // End of `current_`
+  Chunk *chunks_ = nullptr;  // Regular chunks, in the order they're used
+  Chunk *current_ = nullptr; // Chunk being bumped into
+  Chunk *large_chunks_ = nullptr;
+  Destructor *destructors_ = nullptr; // Newest first
+  size_t num_chunks_ = 0;
+
+  Chunk *NewChunk(size_t size) {
+    Chunk *chunk =
+        (Chunk *)FixedPool::AllocateChunk(size, kChunkAlignment, backing_);
+    chunk->next = nullptr;
+    chunk->size = size;
+    num_chunks_++;
+    return chunk;
+  }
+
+  void FreeChunk(Chunk *chunk) {
+    size_t size = chunk->size;
+    FixedPool::FreeChunk(chunk, size, kChunkAlignment, backing_);
+    num_chunks_--;
+  }
+
+  void *AllocateSlow(size_t size, size_t alignment);
+
+public:
+  Arena(size_t chunk_size = kDefaultArenaChunkSize,
+        ChunkBacking backing = ChunkBacking::kHeap)
+      : chunk_size_(chunk_size), backing_(backing) {}
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  ~Arena() {
+    Reset();
+    while (chunks_ != nullptr) {
+      Chunk *next = chunks_->next;
+      FreeChunk(chunks_);
+      chunks_ = next;
+    }
+  }
+
+  // Raw storage, `alignment` must be a power of two. Never freed on its own.
+  inline void *Allocate(size_t size, size_t alignment = kMinAlignment) {
+    assert(size > 0 && "Zero sized allocations would alias the next one.");
+    uintptr_t p = FixedPool::Align(cur_, alignment);
+    if (p + size > end_) [[unlikely]]
+      return AllocateSlow(size, alignment);
+    cur_ = p + size;
+    return (void *)p;
+  }
+
+  template <typename T, typename... Args> inline T *New(Args &&...args) {
+    if constexpr (std::is_trivially_destructible_v<T>) {
+      return new (Allocate(sizeof(T), alignof(T)))
+          T(std::forward<Args>(args)...);
+    } else {
+      Destructor *record =
+          (Destructor *)Allocate(sizeof(Destructor), alignof(Destructor));
+      T *instance =
+          new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+      record->destroy = +[](void *p) { ((T *)p)->~T(); };
+      record->object = instance;
+      record->prev = destructors_;
+      destructors_ = record;
+      return instance;
+    }
+  }
+
+  // Destroys every object in reverse creation order and rewinds to the first
+  // chunk, the regular chunks are kept for the next round.
+  void Reset();
+
+  size_t GetNumOfChunks() const { return num_chunks_; }
+};
+
+inline void *Arena::AllocateSlow(size_t size, size_t alignment) {
+  // Worst case padding of a fresh chunk.
+  size_t needed = sizeof(Chunk) + alignment + size;
+  if (needed > chunk_size_) {
+    Chunk *chunk = NewChunk(needed);
+    chunk->next = large_chunks_;
+    large_chunks_ = chunk;
+    return (void *)FixedPool::Align((uintptr_t)(chunk + 1), alignment);
+  }
+
+  Chunk *chunk = current_ != nullptr ? current_->next : chunks_;
+  if (chunk == nullptr) {
+    chunk = NewChunk(chunk_size_);
+    if (current_ != nullptr)
+      current_->next = chunk;
+    else
+      chunks_ = chunk;
+  }
+  current_ = chunk;
+  cur_ = (uintptr_t)(chunk + 1);
+  end_ = (uintptr_t)chunk + chunk_size_;
+
+  return Allocate(size, alignment);
+}
+
+inline void Arena::Reset() {
+  while (destructors_ != nullptr) {
+    destructors_->destroy(destructors_->object);
+    destructors_ = destructors_->prev;
+  }
+
+  while (large_chunks_ != nullptr) {
+    Chunk *next = large_chunks_->next;
+    FreeChunk(large_chunks_);
+    large_chunks_ = next;
+  }
+
+  current_ = chunks_;
+  cur_ = chunks_ != nullptr ? (uintptr_t)(chunks_ + 1) : 0;
+  end_ = chunks_ != nullptr ? (uintptr_t)chunks_ + chunk_size_ : 0;
+}
+}; // namespace pool
+
+#endif //__ARENA_H__
@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+#include <map>
+#include <random>
+#include <stdio.h>
+
+#include "pool_allocator.h"
+
+struct Order {
+  uint64_t id;
+  uint64_t quantity;
+};
+
+template <typename Alloc>
+using OrderBook = std::map<uint64_t, Order, std::less<uint64_t>,
+                           typename std::allocator_traits<Alloc>::
+                               template rebind_alloc<
+                                   std::pair<const uint64_t, Order>>>;
+
+// Order book style churn, a book of `n` price levels where every iteration
+// cancels one random level and adds another one.
+template <typename Alloc> static void BM_MapChurn(benchmark::State &state) {
+  size_t n = (size_t)state.range(0);
+  OrderBook<Alloc> book;
+  std::mt19937_64 rng(42);
+  for (uint64_t i = 0; i < n; i++)
+    book.emplace(i * 2, Order{i, 1});
+
+  uint64_t next_price = n * 2;
+  for (auto _ : state) {
+    auto it = book.lower_bound(rng() % next_price);
+    if (it == book.end())
+      it = book.begin();
+    book.erase(it);
+    book.emplace(next_price++, Order{next_price, 1});
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+
+BENCHMARK(BM_MapChurn<std::allocator<int>>)->Arg(1000)->Arg(1000000);
+BENCHMARK(BM_MapChurn<PoolAllocator<int>>)->Arg(1000)->Arg(1000000);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
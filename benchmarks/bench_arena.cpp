@@ -0,0 +1,72 @@
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "memory_pool.h"
+
+struct Header {
+  uint64_t key;
+  uint64_t value;
+};
+
+struct Scratch {
+  Scratch(uint64_t p_id) : id(p_id) {}
+  ~Scratch() { benchmark::DoNotOptimize(id); }
+  uint64_t id;
+  uint64_t payload[5] = {};
+};
+
+// A request allocates `n` headers and `n` scratch objects, all of them die
+// when the request is done.
+static void BM_RequestPool(benchmark::State &state) {
+  size_t n = (size_t)state.range(0);
+  std::vector<Header *> headers(n);
+  std::vector<Scratch *> scratches(n);
+  for (auto _ : state) {
+    for (size_t i = 0; i < n; i++) {
+      headers[i] = pool::New<Header>(Header{i, i});
+      scratches[i] = pool::New<Scratch>(i);
+    }
+    benchmark::DoNotOptimize(headers.data());
+    benchmark::DoNotOptimize(scratches.data());
+
+    for (size_t i = 0; i < n; i++) {
+      pool::Delete(headers[i]);
+      pool::Delete(scratches[i]);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * n * 2);
+}
+
+static void BM_RequestArena(benchmark::State &state) {
+  size_t n = (size_t)state.range(0);
+  pool::Arena arena;
+  for (auto _ : state) {
+    for (size_t i = 0; i < n; i++) {
+      benchmark::DoNotOptimize(arena.New<Header>(Header{i, i}));
+      benchmark::DoNotOptimize(arena.New<Scratch>(i));
+    }
+
+    arena.Reset();
+  }
+  state.SetItemsProcessed(state.iterations() * n * 2);
+}
+
+BENCHMARK(BM_RequestPool)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK(BM_RequestArena)->Arg(16)->Arg(256)->Arg(4096);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
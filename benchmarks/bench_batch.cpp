@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+
+#include "memory_pool.h"
+
+struct Message {
+  Message(uint64_t p_id) : id(p_id) {}
+  uint64_t id;
+  uint64_t payload[3] = {};
+};
+
+// Allocates `n` objects of one type at once, like a request handler would,
+// then frees them.
+static void BM_NewSingle(benchmark::State &state) {
+  std::vector<Message *> msgs((size_t)state.range(0));
+  for (auto _ : state) {
+    for (auto &msg : msgs)
+      msg = pool::New<Message>(42);
+    benchmark::DoNotOptimize(msgs.data());
+
+    for (auto msg : msgs)
+      pool::Delete(msg);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_NewBatch(benchmark::State &state) {
+  std::vector<Message *> msgs((size_t)state.range(0));
+  for (auto _ : state) {
+    pool::NewBatch<Message>(msgs, 42);
+    benchmark::DoNotOptimize(msgs.data());
+
+    for (auto msg : msgs)
+      pool::Delete(msg);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+static void BM_DeleteBatch(benchmark::State &state) {
+  std::vector<Message *> msgs((size_t)state.range(0));
+  for (auto _ : state) {
+    pool::NewBatch<Message>(msgs, 42);
+    benchmark::DoNotOptimize(msgs.data());
+
+    pool::DeleteBatch<Message>(msgs);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_NewSingle)->Arg(16)->Arg(64)->Arg(256)->Arg(4096);
+BENCHMARK(BM_NewBatch)->Arg(16)->Arg(64)->Arg(256)->Arg(4096);
+BENCHMARK(BM_DeleteBatch)->Arg(16)->Arg(64)->Arg(256)->Arg(4096);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+
+#include "memory_pool.h"
+
+// Same node, one grows its chunks geometrically(the default), the other is
+// pinned to `kDefaultBlockCount` blocks per chunk like the old pool was.
+struct GrowthNode {
+  uint64_t value;
+};
+
+struct FixedNode {
+  uint64_t value;
+};
+
+template <> struct PoolTraits<FixedNode> : DefaultPoolTraits {
+  static constexpr uint32_t kMaxBlockCount = kDefaultBlockCount;
+};
+
+// Each benchmark runs a single iteration, so it measures a pool growing from
+// its first chunk to `live_objects` live objects. `Clear` keeps the chunks
+// around, repetitions after the first one only measure reuse.
+template <typename Node> static void BM_Grow(benchmark::State &state) {
+  const size_t live_objects = (size_t)state.range(0);
+  auto &node_pool = Pool<Node>::Instance();
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < live_objects; i++)
+      benchmark::DoNotOptimize(node_pool.New(Node{i}));
+  }
+
+  state.SetItemsProcessed((int64_t)live_objects);
+  state.counters["chunks"] = (double)node_pool.GetNumOfChunks();
+  node_pool.Clear();
+}
+
+BENCHMARK_TEMPLATE(BM_Grow, GrowthNode)
+    ->Arg(1000)
+    ->Arg(1000000)
+    ->Arg(100000000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Grow, FixedNode)
+    ->Arg(1000)
+    ->Arg(1000000)
+    ->Arg(100000000)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+struct SparseNode {
+  uint64_t value;
+  ~SparseNode() { benchmark::DoNotOptimize(value); }
+};
+
+// 10M slots with only `live_objects` of them spread evenly still in use,
+// `Clear` skips the empty bitmap words so it scales with the live count.
+static void BM_ClearSparse(benchmark::State &state) {
+  constexpr size_t kSlots = 10000000;
+  const size_t live_objects = (size_t)state.range(0);
+  auto &node_pool = Pool<SparseNode>::Instance();
+  std::vector<SparseNode *> nodes(kSlots);
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (size_t i = 0; i < kSlots; i++)
+      nodes[i] = node_pool.New(SparseNode{i});
+    for (size_t i = 0; i < kSlots; i++) {
+      if (i % (kSlots / live_objects) != 0)
+        node_pool.Delete(nodes[i]);
+    }
+    state.ResumeTiming();
+
+    node_pool.Clear();
+  }
+}
+
+BENCHMARK(BM_ClearSparse)
+    ->Arg(1000)
+    ->Arg(100000)
+    ->Arg(10000000)
+    ->Iterations(3)
+    ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
@@ -41,6 +41,46 @@ static void ManualMalloc(bool recreating = false) {
     ManualMalloc(true);
 }
 
+// Same as `MemoryPool` but through the type-erased size class pools.
+static void SizeClassPool(bool recreating = false) {
+  std::vector<MyObj *> objs;
+  for (size_t i = 0; i <= kDefaultBlockCount + 5; i++) {
+    std::string name = "Child" + std::to_string(i);
+    void *space = pool::Allocate(sizeof(MyObj), alignof(MyObj));
+    objs.push_back(new (space) MyObj(name, i));
+  }
+
+  for (auto &ptr : objs) {
+    ptr->~MyObj();
+    pool::Free(ptr);
+  }
+  objs.clear();
+
+  if (!recreating)
+    SizeClassPool(true);
+}
+
+constexpr uint32_t kFixedPoolBlocks = kDefaultBlockCount + 6;
+
+// Same allocate everything, free everything pattern straight on a single pool,
+// runtime sized vs compile-time sized.
+template <typename FixedPoolType>
+static void FixedPoolRoundTrip(FixedPoolType *pool, bool recreating = false) {
+  MyObj *objs[kFixedPoolBlocks];
+  for (size_t i = 0; i < kFixedPoolBlocks; i++) {
+    std::string name = "Child" + std::to_string(i);
+    objs[i] = new (pool->Allocate()) MyObj(name, i);
+  }
+
+  for (auto &ptr : objs) {
+    ptr->~MyObj();
+    pool->DeAllocate(ptr);
+  }
+
+  if (!recreating)
+    FixedPoolRoundTrip(pool, true);
+}
+
 static void BM_MemoryPool(benchmark::State &state) {
   for (auto _ : state) {
     MemoryPool();
@@ -53,8 +93,34 @@ static void BM_ManualMalloc(benchmark::State &state) {
   }
 }
 
+static void BM_SizeClassPool(benchmark::State &state) {
+  for (auto _ : state) {
+    SizeClassPool();
+  }
+}
+
+static void BM_FixedPool(benchmark::State &state) {
+  FixedPool *pool = FixedPool::Create(sizeof(MyObj), kFixedPoolBlocks);
+  for (auto _ : state) {
+    FixedPoolRoundTrip(pool);
+  }
+  delete pool;
+}
+
+static void BM_StaticFixedPool(benchmark::State &state) {
+  auto *pool =
+      new StaticFixedPool<sizeof(MyObj), kFixedPoolBlocks, alignof(MyObj)>();
+  for (auto _ : state) {
+    FixedPoolRoundTrip(pool);
+  }
+  delete pool;
+}
+
 BENCHMARK(BM_MemoryPool)->Iterations(kBenchmarkIterations);
 BENCHMARK(BM_ManualMalloc)->Iterations(kBenchmarkIterations);
+BENCHMARK(BM_SizeClassPool)->Iterations(kBenchmarkIterations);
+BENCHMARK(BM_FixedPool)->Iterations(kBenchmarkIterations);
+BENCHMARK(BM_StaticFixedPool)->Iterations(kBenchmarkIterations);
 
 int main(int argc, char **argv) {
   char arg0_default[] = "benchmark";
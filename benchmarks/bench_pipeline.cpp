@@ -0,0 +1,90 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <stdio.h>
+#include <thread>
+
+#include "memory_pool.h"
+
+struct Message {
+  Message(uint64_t p_id) : id(p_id) {}
+  uint64_t id;
+  uint64_t payload[3] = {};
+};
+
+// Same message, but every remote delete is handed over on its own.
+struct UnbufferedMessage : Message {
+  using Message::Message;
+};
+
+template <> struct PoolTraits<UnbufferedMessage> : DefaultPoolTraits {
+  static constexpr uint32_t kRemoteFreeBatch = 0;
+};
+
+// Blocks are reused by whichever thread frees them, nothing goes back.
+struct MagazineMessage : Message {
+  using Message::Message;
+};
+
+template <> struct PoolTraits<MagazineMessage> : DefaultPoolTraits {
+  static constexpr uint32_t kMagazineSize = 64;
+};
+
+// The benchmark thread allocates `n` messages and passes them to a consumer
+// thread which deletes them, every delete is a remote free back to the
+// producer's pool.
+template <typename T> static void BM_Pipeline(benchmark::State &state) {
+  size_t n = (size_t)state.range(0);
+  moodycamel::ConcurrentQueue<T *> handoff;
+  std::atomic<size_t> consumed = 0;
+  std::atomic<bool> stop = false;
+
+  std::thread consumer([&] {
+    T *items[64];
+    while (!stop.load(std::memory_order_relaxed)) {
+      size_t count = handoff.try_dequeue_bulk(items, 64);
+      if (count == 0) {
+        // Idle, hand the partial batches over before waiting.
+        pool::FlushRemoteFrees<T>();
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < count; i++)
+        pool::Delete(items[i]);
+      consumed.fetch_add(count, std::memory_order_release);
+    }
+    pool::FlushRemoteFrees<T>();
+  });
+
+  moodycamel::ProducerToken token(handoff);
+  size_t produced = 0;
+  for (auto _ : state) {
+    for (size_t i = 0; i < n; i++)
+      handoff.enqueue(token, pool::New<T>(i));
+    produced += n;
+    while (consumed.load(std::memory_order_acquire) != produced)
+      std::this_thread::yield();
+  }
+  stop = true;
+  consumer.join();
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+BENCHMARK(BM_Pipeline<UnbufferedMessage>)->Arg(256)->Arg(16384);
+BENCHMARK(BM_Pipeline<Message>)->Arg(256)->Arg(16384);
+BENCHMARK(BM_Pipeline<MagazineMessage>)->Arg(256)->Arg(16384);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
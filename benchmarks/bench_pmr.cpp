@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+#include <list>
+#include <map>
+#include <stdio.h>
+#include <unordered_map>
+
+#include "memory_resource.h"
+
+// Fills and empties node based containers through a memory resource, every
+// element is a node allocation.
+template <typename Resource> static void BM_PmrMap(benchmark::State &state) {
+  Resource resource;
+  size_t n = (size_t)state.range(0);
+  for (auto _ : state) {
+    std::pmr::map<uint64_t, uint64_t> map(&resource);
+    for (uint64_t i = 0; i < n; i++)
+      map.emplace((i * 2654435761u) % n, i);
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+template <typename Resource> static void BM_PmrList(benchmark::State &state) {
+  Resource resource;
+  size_t n = (size_t)state.range(0);
+  for (auto _ : state) {
+    std::pmr::list<uint64_t> list(&resource);
+    for (uint64_t i = 0; i < n; i++)
+      list.push_back(i);
+    benchmark::DoNotOptimize(list.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+template <typename Resource>
+static void BM_PmrUnorderedMap(benchmark::State &state) {
+  Resource resource;
+  size_t n = (size_t)state.range(0);
+  for (auto _ : state) {
+    std::pmr::unordered_map<uint64_t, uint64_t> map(&resource);
+    for (uint64_t i = 0; i < n; i++)
+      map.emplace(i, i);
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+// Plain `new`/`delete` baseline.
+struct NewDeleteResource : std::pmr::memory_resource {
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+
+#define PMR_BENCHMARKS(BM)                                                     \
+  BENCHMARK(BM<pool::MemoryResource>)->Arg(1000)->Arg(100000);                 \
+  BENCHMARK(BM<pool::UnsyncMemoryResource>)->Arg(1000)->Arg(100000);           \
+  BENCHMARK(BM<std::pmr::synchronized_pool_resource>)                          \
+      ->Arg(1000)                                                              \
+      ->Arg(100000);                                                           \
+  BENCHMARK(BM<std::pmr::unsynchronized_pool_resource>)                        \
+      ->Arg(1000)                                                              \
+      ->Arg(100000);                                                           \
+  BENCHMARK(BM<NewDeleteResource>)->Arg(1000)->Arg(100000)
+
+PMR_BENCHMARKS(BM_PmrMap);
+PMR_BENCHMARKS(BM_PmrList);
+PMR_BENCHMARKS(BM_PmrUnorderedMap);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <stdio.h>
+
+#include "pool_allocator.h"
+
+struct Message {
+  Message(uint64_t p_id) : id(p_id) {}
+  uint64_t id;
+  uint64_t payload[3] = {};
+};
+
+constexpr size_t kFanOut = 4;
+
+// Creates `n` messages and shares each of them with `kFanOut` consumers, the
+// messages die when the last consumer lets go.
+template <auto MakeShared>
+static void BM_FanOut(benchmark::State &state) {
+  size_t n = (size_t)state.range(0);
+  std::vector<std::shared_ptr<Message>> consumers[kFanOut];
+  for (auto &consumer : consumers)
+    consumer.reserve(n);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < n; i++) {
+      std::shared_ptr<Message> msg = MakeShared(i);
+      for (auto &consumer : consumers)
+        consumer.push_back(msg);
+    }
+    for (auto &consumer : consumers)
+      consumer.clear();
+  }
+  state.SetItemsProcessed(state.iterations() * n);
+}
+
+static std::shared_ptr<Message> StdMakeShared(uint64_t id) {
+  return std::make_shared<Message>(id);
+}
+
+// Pooled object, but the control block is a separate heap allocation.
+static std::shared_ptr<Message> PoolDeleterShared(uint64_t id) {
+  return std::shared_ptr<Message>(pool::New<Message>(id),
+                                  pool::Deleter<Message>());
+}
+
+static std::shared_ptr<Message> PoolMakeShared(uint64_t id) {
+  return pool::make_shared<Message>(id);
+}
+
+BENCHMARK(BM_FanOut<StdMakeShared>)->Arg(64)->Arg(4096);
+BENCHMARK(BM_FanOut<PoolDeleterShared>)->Arg(64)->Arg(4096);
+BENCHMARK(BM_FanOut<PoolMakeShared>)->Arg(64)->Arg(4096);
+
+int main(int argc, char **argv) {
+  char arg0_default[] = "benchmark";
+  char *args_default = arg0_default;
+  if (!argv) {
+    argc = 1;
+    argv = &args_default;
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return 0;
+}
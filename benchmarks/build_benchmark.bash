@@ -22,6 +22,34 @@ build_google_benchmark() {
     g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_naive.cpp ../fixed_pool.cpp -I../ \
         -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o      \
         build/bench_naive
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_growth.cpp ../fixed_pool.cpp -I../ \
+        -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o       \
+        build/bench_growth
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_batch.cpp ../fixed_pool.cpp -I../  \
+        -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o       \
+        build/bench_batch
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_arena.cpp ../fixed_pool.cpp -I../  \
+        -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o       \
+        build/bench_arena
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_pmr.cpp ../fixed_pool.cpp -I../    \
+        -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o       \
+        build/bench_pmr
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_allocator.cpp ../fixed_pool.cpp      \
+        -I../ -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread    \
+        -o build/bench_allocator
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_shared.cpp ../fixed_pool.cpp -I../ \
+        -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread -o       \
+        build/bench_shared
+
+    g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG bench_pipeline.cpp ../fixed_pool.cpp      \
+        -I../ -isystem benchmark/include -Lbenchmark/build/src -lbenchmark -lpthread    \
+        -o build/bench_pipeline
 }
 
 build_google_benchmark
@@ -35,3 +63,15 @@ g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG -pg perf2.cpp ../fixed_pool.cpp -I../
     -o build/perf2_pg
 g++ -std=c++20 -Wall -Werror -O3 -g -DNDEBUG perf2.cpp ../fixed_pool.cpp -I../       \
     -o build/perf2
+
+g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG perf_tlb.cpp ../fixed_pool.cpp -I../      \
+    -o build/perf_tlb
+
+g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG perf_depot.cpp ../fixed_pool.cpp -I../    \
+    -lpthread -o build/perf_depot
+
+g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG trace_replay.cpp ../fixed_pool.cpp -I../  \
+    -lpthread -o build/trace_replay
+
+g++ -std=c++20 -Wall -Werror -O3 -DNDEBUG perf_latency.cpp ../fixed_pool.cpp -I../ \
+    -lpthread -o build/perf_latency
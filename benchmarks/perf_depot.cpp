@@ -0,0 +1,85 @@
+// Reports the peak RSS of a skewed load, one thread frees everything it
+// allocated in random order and goes idle, then another thread allocates as
+// much. Once with the chunk depot and once without, each in its own process.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <thread>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+
+constexpr size_t kObjects = 128 * 1024;
+
+template <uint32_t DepotChunks> struct Obj {
+  uint64_t data[8];
+};
+
+template <uint32_t DepotChunks>
+struct PoolTraits<Obj<DepotChunks>> : DefaultPoolTraits {
+  static constexpr uint32_t kDepotChunks = DepotChunks;
+};
+
+template <typename T> static std::vector<T *> Fill() {
+  std::vector<T *> objs(kObjects);
+  for (size_t i = 0; i < kObjects; i++)
+    objs[i] = pool::New<T>(T{{i}});
+  return objs;
+}
+
+template <uint32_t DepotChunks> static void Run(const char *name) {
+  using ObjType = Obj<DepotChunks>;
+  std::atomic<bool> emptied = false;
+  std::atomic<bool> done = false;
+
+  // Random frees leave every chunk empty only at the very end, there is no
+  // later release check to give them back.
+  std::thread idle([&] {
+    std::vector<ObjType *> objs = Fill<ObjType>();
+    std::shuffle(objs.begin(), objs.end(), std::mt19937_64(42));
+    for (ObjType *obj : objs)
+      pool::Delete(obj);
+    emptied = true;
+    while (!done)
+      std::this_thread::yield();
+  });
+  while (!emptied)
+    std::this_thread::yield();
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<ObjType *> objs = Fill<ObjType>();
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  done = true;
+  idle.join();
+
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("%-8s peak RSS %6ld KiB, second fill %6.2f ms\n", name,
+         usage.ru_maxrss,
+         std::chrono::duration<double, std::milli>(elapsed).count());
+
+  for (ObjType *obj : objs)
+    pool::Delete(obj);
+}
+
+// Peak RSS is per process, every run gets a fresh one.
+template <uint32_t DepotChunks> static void RunForked(const char *name) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    Run<DepotChunks>(name);
+    fflush(stdout);
+    _exit(0);
+  }
+  waitpid(pid, nullptr, 0);
+}
+
+int main() {
+  RunForked<0>("no depot");
+  RunForked<DefaultPoolTraits::kDepotChunks>("depot");
+}
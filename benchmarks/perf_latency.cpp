@@ -0,0 +1,64 @@
+// Percentiles of `pool::New`/`pool::Delete` by path. The `bench_naive`
+// pattern on one thread, then a producer whose objects a consumer thread
+// deletes, so its news keep collecting remote frees.
+#define MEMORY_POOL_LATENCY 1
+
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "bench_common.h"
+#include "memory_pool.h"
+
+constexpr size_t kIterations = 100000;
+constexpr size_t kMessages = 1024 * 1024;
+
+struct Message {
+  uint64_t data[8];
+};
+
+static void MemoryPool(bool recreating = false) {
+  std::vector<MyObj *> objs;
+  for (size_t i = 0; i <= kDefaultBlockCount + 5; i++) {
+    std::string name = "Child" + std::to_string(i);
+    objs.push_back(pool::New<MyObj>(name, i));
+  }
+
+  for (auto &ptr : objs)
+    pool::Delete(ptr);
+  objs.clear();
+
+  if (!recreating)
+    MemoryPool(true);
+}
+
+static void Pipeline() {
+  constexpr size_t kSlots = 4096;
+  std::vector<std::atomic<Message *>> slots(kSlots);
+  std::thread consumer([&slots] {
+    for (size_t i = 0; i < kMessages; i++) {
+      std::atomic<Message *> &slot = slots[i % kSlots];
+      Message *message;
+      while ((message = slot.exchange(nullptr)) == nullptr)
+        std::this_thread::yield();
+      pool::Delete(message);
+    }
+    pool::FlushRemoteFrees<Message>();
+  });
+  for (size_t i = 0; i < kMessages; i++) {
+    std::atomic<Message *> &slot = slots[i % kSlots];
+    while (slot.load() != nullptr)
+      std::this_thread::yield();
+    slot.store(pool::New<Message>(Message{{i}}));
+  }
+  consumer.join();
+}
+
+int main() {
+  for (size_t i = 0; i < kIterations; i++)
+    MemoryPool();
+  Pipeline();
+  pool::Latencies<MyObj>().Write(std::cout, "MyObj");
+  pool::Latencies<Message>().Write(std::cout, "Message");
+}
@@ -0,0 +1,101 @@
+// Reports dTLB load misses per traversal of a big pooled linked list, once with
+// heap backed chunks and once with huge page backed chunks.
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+
+constexpr size_t kNodes = 4 * 1024 * 1024;
+constexpr size_t kTraversals = 10;
+
+template <ChunkBacking Backing> struct Node {
+  Node *next;
+  uint64_t value;
+  uint64_t pad[6];
+};
+
+// Both backings use the same 1M block(64 MiB) chunks, only the pages behind
+// them differ.
+template <ChunkBacking Backing>
+struct PoolTraits<Node<Backing>> : DefaultPoolTraits {
+  static constexpr uint32_t kMaxBlockCount = 1 << 20;
+  static constexpr ChunkBacking kBacking = Backing;
+  static constexpr size_t kMaxHeapChunkSize = 128 * 1024 * 1024;
+};
+
+static int OpenDTLBMissCounter() {
+  perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HW_CACHE;
+  attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+template <ChunkBacking Backing> static void Run(const char *name) {
+  using NodeType = Node<Backing>;
+  std::vector<NodeType *> nodes(kNodes);
+  for (size_t i = 0; i < kNodes; i++)
+    nodes[i] = pool::New<NodeType>(NodeType{nullptr, i, {}});
+
+  // Random visiting order, so every hop is likely to land on another page.
+  std::shuffle(nodes.begin(), nodes.end(), std::mt19937_64(42));
+  for (size_t i = 0; i + 1 < kNodes; i++)
+    nodes[i]->next = nodes[i + 1];
+  NodeType *head = nodes[0];
+
+  int fd = OpenDTLBMissCounter();
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t sum = 0;
+  for (size_t t = 0; t < kTraversals; t++) {
+    for (NodeType *n = head; n != nullptr; n = n->next)
+      sum += n->value;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  long long misses = -1;
+  if (fd >= 0) {
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &misses, sizeof(misses)) != sizeof(misses))
+      misses = -1;
+    close(fd);
+  }
+
+  double ms =
+      std::chrono::duration<double, std::milli>(elapsed).count() / kTraversals;
+  if (misses >= 0) {
+    printf("%-10s %8.2f ms/traversal %12.0f dTLB-load-misses/traversal "
+           "(sum: %llu)\n",
+           name, ms, (double)misses / kTraversals, (unsigned long long)sum);
+  } else {
+    printf("%-10s %8.2f ms/traversal, dTLB counter unavailable, check "
+           "/proc/sys/kernel/perf_event_paranoid (sum: %llu)\n",
+           name, ms, (unsigned long long)sum);
+  }
+
+  for (auto node : nodes)
+    pool::Delete(node);
+}
+
+int main() {
+  Run<ChunkBacking::kHeap>("heap");
+  Run<ChunkBacking::kHugePages>("hugepages");
+}
@@ -0,0 +1,145 @@
+// Reads a `pool::EventTrace` file, optionally converts it to Chrome trace
+// JSON, then replays its New/Delete sequence on one thread through the size
+// class pools and through malloc:
+//   trace_replay pool.trace [pool.json]
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unordered_map>
+#include <vector>
+
+#include "memory_pool.h"
+
+struct Op {
+  uint32_t size;
+  uint32_t slot;
+  bool free;
+};
+
+// Every thread's events in time order, each live block gets a slot so the
+// timed loop doesn't look anything up.
+static std::vector<Op> BuildOps(const pool::TraceFile &trace,
+                                uint32_t &num_slots) {
+  std::unordered_map<uint32_t, uint32_t> sizes;
+  for (const pool::TraceFile::Type &type : trace.types)
+    sizes[type.id] = type.size;
+
+  std::vector<const pool::TraceEvent *> events;
+  for (const pool::TraceFile::Thread &thread : trace.threads) {
+    for (const pool::TraceEvent &event : thread.events) {
+      if (event.kind == pool::TraceKind::kNew ||
+          event.kind == pool::TraceKind::kDelete)
+        events.push_back(&event);
+    }
+  }
+  std::stable_sort(events.begin(), events.end(),
+                   [](const pool::TraceEvent *a, const pool::TraceEvent *b) {
+                     return a->ticks < b->ticks;
+                   });
+
+  std::vector<Op> ops;
+  struct Live {
+    uint32_t slot;
+    uint32_t size;
+  };
+  std::unordered_map<uint64_t, Live> live;
+  std::vector<uint32_t> free_slots;
+  num_slots = 0;
+  for (const pool::TraceEvent *event : events) {
+    if (event->kind == pool::TraceKind::kNew) {
+      uint32_t slot;
+      if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+      } else {
+        slot = num_slots++;
+      }
+      uint32_t size = std::max<uint32_t>(sizes[event->type], 1);
+      live[event->ptr] = {slot, size};
+      ops.push_back({size, slot, false});
+      continue;
+    }
+    // Allocated before the oldest event the ring kept.
+    auto it = live.find(event->ptr);
+    if (it == live.end())
+      continue;
+    ops.push_back({it->second.size, it->second.slot, true});
+    free_slots.push_back(it->second.slot);
+    live.erase(it);
+  }
+  return ops;
+}
+
+template <typename Alloc, typename Free>
+static double Replay(const std::vector<Op> &ops, uint32_t num_slots,
+                     Alloc alloc, Free free_block) {
+  std::vector<void *> slots(num_slots, nullptr);
+  std::vector<uint32_t> slot_sizes(num_slots, 0);
+  auto start = std::chrono::steady_clock::now();
+  for (const Op &op : ops) {
+    if (!op.free) {
+      slots[op.slot] = alloc(op.size);
+      slot_sizes[op.slot] = op.size;
+    } else {
+      free_block(slots[op.slot], op.size);
+      slots[op.slot] = nullptr;
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  for (uint32_t i = 0; i < num_slots; i++) {
+    if (slots[i] != nullptr)
+      free_block(slots[i], slot_sizes[i]);
+  }
+  return std::chrono::duration<double, std::nano>(elapsed).count();
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace> [chrome json]\n", argv[0]);
+    return 1;
+  }
+  std::ifstream in(argv[1], std::ios::binary);
+  pool::TraceFile trace;
+  if (!pool::EventTrace::Read(in, trace)) {
+    fprintf(stderr, "%s: not a pool trace\n", argv[1]);
+    return 1;
+  }
+  if (argc > 2) {
+    std::ofstream json(argv[2]);
+    pool::EventTrace::WriteChromeJson(trace, json);
+  }
+
+  size_t num_events = 0;
+  for (const pool::TraceFile::Thread &thread : trace.threads)
+    num_events += thread.events.size();
+  uint32_t num_slots = 0;
+  std::vector<Op> ops = BuildOps(trace, num_slots);
+  printf("%zu threads, %zu types, %zu events, %zu replayed ops, peak %u "
+         "live\n",
+         trace.threads.size(), trace.types.size(), num_events, ops.size(),
+         num_slots);
+  if (ops.empty())
+    return 0;
+
+  // Blocks bigger than every size class go to malloc in both runs.
+  double pooled = Replay(
+      ops, num_slots,
+      [](uint32_t size) {
+        return size <= SizeClasses::kMaxSize ? pool::Allocate(size)
+                                             : malloc(size);
+      },
+      [](void *p, uint32_t size) {
+        if (size <= SizeClasses::kMaxSize)
+          pool::Free(p);
+        else
+          free(p);
+      });
+  double system = Replay(
+      ops, num_slots, [](uint32_t size) { return malloc(size); },
+      [](void *p, uint32_t) { free(p); });
+  printf("pool:   %.1f ns/op\nmalloc: %.1f ns/op\n", pooled / ops.size(),
+         system / ops.size());
+  return 0;
+}
@@ -0,0 +1,421 @@
+#ifndef __EVENT_TRACE_H__
+#define __EVENT_TRACE_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define EVENT_TRACE_HAS_TSC 1
+#endif
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define EVENT_TRACE_HAS_DEMANGLE 1
+#endif
+
+// Opt-in, every `Pool<T>` call records an event once this is 1.
+#ifndef MEMORY_POOL_TRACE
+#define MEMORY_POOL_TRACE 0
+#endif
+
+// Events each thread keeps, the oldest ones are overwritten. Power of two.
+#ifndef MEMORY_POOL_TRACE_EVENTS
+#define MEMORY_POOL_TRACE_EVENTS (64 * 1024)
+#endif
+
+constexpr bool kEventTrace = MEMORY_POOL_TRACE;
+
+namespace pool {
+enum class TraceKind : uint8_t {
+  kNew,      // `ptr` handed out of `chunk`
+  kDelete,   // `ptr` freed, `kTraceRemote` when another thread owns it
+  kCollect,  // The owner took `ptr` blocks other threads freed
+  kNewChunk, // `chunk` of `ptr` blocks added
+};
+
+constexpr uint8_t kTraceRemote = 1;
+
+// 32 bytes, the file holds them as they are in memory.
+struct TraceEvent {
+  uint64_t ticks; // See `TraceFile::ns_per_tick`
+  uint64_t ptr;
+  uint64_t chunk;
+  uint32_t type;
+  TraceKind kind;
+  uint8_t flags;
+  uint16_t unused;
+};
+
+static_assert(sizeof(TraceEvent) == 32, "Trace events are 32 bytes.");
+
+// A trace read back by `EventTrace::Read`.
+struct TraceFile {
+  struct Type {
+    uint32_t id;
+    uint32_t size;
+    std::string name;
+  };
+  struct Thread {
+    uint32_t index;
+    std::vector<TraceEvent> events; // Oldest first
+  };
+
+  double ns_per_tick = 1.0;
+  uint64_t start_ticks = 0; // Clock of the first thread's first event
+  std::vector<Type> types;
+  std::vector<Thread> threads;
+};
+
+// Per thread ring buffers of the `Pool<T>` calls, for looking at the real
+// alloc/free sequence of a program:
+//   g++ -DMEMORY_POOL_TRACE=1 ...
+//   pool::EventTrace::WriteFile("pool.trace");
+//   benchmarks/build/trace_replay pool.trace pool.json # chrome://tracing
+//
+// Only the owner thread writes its ring, an event is a TSC read and a 32 byte
+// store followed by a release store of the ring head, no locks and no
+// read-modify-writes. Rings are kept after their thread exits so its events
+// can still be written out. `Write` copies the rings as they are, the traced
+// threads should be quiet(joined, or done allocating) while it runs.
+class EventTrace {
+public:
+  static constexpr size_t kEvents = MEMORY_POOL_TRACE_EVENTS;
+
+  static_assert((kEvents & (kEvents - 1)) == 0,
+                "MEMORY_POOL_TRACE_EVENTS must be a power of two.");
+
+  static inline void Record(TraceKind kind, uint32_t type, const void *ptr,
+                            const void *chunk, uint8_t flags = 0) {
+    if constexpr (!kEventTrace)
+      return;
+    Ring *ring = ring_;
+    if (ring == nullptr) [[unlikely]]
+      ring = NewRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceEvent &event = ring->events[head & (kEvents - 1)];
+    event.ticks = Ticks();
+    event.ptr = (uint64_t)(uintptr_t)ptr;
+    event.chunk = (uint64_t)(uintptr_t)chunk;
+    event.type = type;
+    event.kind = kind;
+    event.flags = flags;
+    ring->head.store(head + 1, std::memory_order_release);
+  }
+
+  // Id of a traced type, written to the file with its name and size. 0 is
+  // never handed out.
+  static uint32_t RegisterType(const char *mangled_name, size_t size);
+
+  static bool WriteFile(const char *path);
+  static void Write(std::ostream &out);
+  static bool Read(std::istream &in, TraceFile &trace);
+
+  // Every event as an instant event on its thread's track plus a live block
+  // counter per type, in the JSON chrome://tracing and Perfetto load.
+  static void WriteChromeJson(const TraceFile &trace, std::ostream &out);
+
+  // Drops every recorded event, the rings stay allocated.
+  static void Clear();
+
+private:
+  static constexpr char kMagic[8] = {'P', 'O', 'O', 'L', 'T', 'R', 'C', '1'};
+
+  struct Ring {
+    std::atomic<uint64_t> head{0};
+    uint32_t index;
+    Ring *next;
+    TraceEvent events[kEvents];
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    std::vector<TraceFile::Type> types;
+    std::atomic<Ring *> rings{nullptr};
+    uint32_t num_rings = 0;
+    // Clock pair taken with the first ring, `Write` takes another one to
+    // scale the ticks.
+    uint64_t start_ticks = 0;
+    std::chrono::steady_clock::time_point start_time;
+  };
+
+  // Never destroyed, static destructors still delete objects.
+  static Registry &GetRegistry() {
+    static Registry *registry = new Registry();
+    return *registry;
+  }
+
+  static inline uint64_t Ticks() {
+#ifdef EVENT_TRACE_HAS_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static Ring *NewRing();
+
+  static inline thread_local Ring *ring_ = nullptr;
+};
+
+inline EventTrace::Ring *EventTrace::NewRing() {
+  Ring *ring = new Ring();
+  Registry &registry = GetRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.num_rings == 0) {
+      registry.start_ticks = Ticks();
+      registry.start_time = std::chrono::steady_clock::now();
+    }
+    ring->index = registry.num_rings++;
+  }
+  ring->next = registry.rings.load(std::memory_order_relaxed);
+  while (!registry.rings.compare_exchange_weak(ring->next, ring,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+    ;
+  ring_ = ring;
+  return ring;
+}
+
+inline uint32_t EventTrace::RegisterType(const char *mangled_name,
+                                         size_t size) {
+  std::string name = mangled_name;
+#ifdef EVENT_TRACE_HAS_DEMANGLE
+  int status = 0;
+  char *demangled =
+      abi::__cxa_demangle(mangled_name, nullptr, nullptr, &status);
+  if (status == 0 && demangled != nullptr)
+    name = demangled;
+  free(demangled);
+#endif
+  Registry &registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  uint32_t id = (uint32_t)registry.types.size() + 1;
+  registry.types.push_back({id, (uint32_t)size, std::move(name)});
+  return id;
+}
+
+inline void EventTrace::Clear() {
+  Registry &registry = GetRegistry();
+  for (Ring *ring = registry.rings.load(std::memory_order_acquire);
+       ring != nullptr; ring = ring->next)
+    ring->head.store(0, std::memory_order_relaxed);
+}
+
+// File layout, host byte order:
+//   magic[8], double ns_per_tick, u64 start_ticks, u32 types, u32 threads
+//   types:   u32 id, u32 size, u32 name length, name
+//   threads: u32 index, u32 unused, u64 events, `TraceEvent`s oldest first
+inline void EventTrace::Write(std::ostream &out) {
+  Registry &registry = GetRegistry();
+  std::vector<TraceFile::Type> types;
+  uint64_t start_ticks;
+  double ns_per_tick = 1.0;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    types = registry.types;
+    start_ticks = registry.start_ticks;
+#ifdef EVENT_TRACE_HAS_TSC
+    if (registry.num_rings > 0) {
+      uint64_t ticks = Ticks() - registry.start_ticks;
+      auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - registry.start_time)
+                    .count();
+      if (ticks > 0)
+        ns_per_tick = (double)ns / (double)ticks;
+    }
+#endif
+  }
+
+  std::vector<Ring *> rings;
+  for (Ring *ring = registry.rings.load(std::memory_order_acquire);
+       ring != nullptr; ring = ring->next)
+    rings.push_back(ring);
+
+  auto put = [&out](const void *data, size_t size) {
+    out.write((const char *)data, (std::streamsize)size);
+  };
+  auto put32 = [&put](uint32_t v) { put(&v, sizeof(v)); };
+  auto put64 = [&put](uint64_t v) { put(&v, sizeof(v)); };
+
+  put(kMagic, sizeof(kMagic));
+  put(&ns_per_tick, sizeof(ns_per_tick));
+  put64(start_ticks);
+  put32((uint32_t)types.size());
+  put32((uint32_t)rings.size());
+  for (const TraceFile::Type &type : types) {
+    put32(type.id);
+    put32(type.size);
+    put32((uint32_t)type.name.size());
+    put(type.name.data(), type.name.size());
+  }
+  // Oldest ring first.
+  for (auto it = rings.rbegin(); it != rings.rend(); ++it) {
+    Ring *ring = *it;
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t first = head > kEvents ? head - kEvents : 0;
+    put32(ring->index);
+    put32(0);
+    put64(head - first);
+    for (uint64_t i = first; i < head; i++)
+      put(&ring->events[i & (kEvents - 1)], sizeof(TraceEvent));
+  }
+}
+
+inline bool EventTrace::WriteFile(const char *path) {
+  std::ofstream out(path, std::ios::binary);
+  Write(out);
+  out.close();
+  return !out.fail();
+}
+
+inline bool EventTrace::Read(std::istream &in, TraceFile &trace) {
+  auto get = [&in](void *data, size_t size) {
+    return (bool)in.read((char *)data, (std::streamsize)size);
+  };
+  char magic[sizeof(kMagic)];
+  uint32_t num_types = 0, num_threads = 0;
+  if (!get(magic, sizeof(magic)) || memcmp(magic, kMagic, sizeof(kMagic)) ||
+      !get(&trace.ns_per_tick, sizeof(double)) ||
+      !get(&trace.start_ticks, sizeof(uint64_t)) ||
+      !get(&num_types, sizeof(uint32_t)) ||
+      !get(&num_threads, sizeof(uint32_t)))
+    return false;
+
+  trace.types.resize(num_types);
+  for (TraceFile::Type &type : trace.types) {
+    uint32_t length = 0;
+    if (!get(&type.id, sizeof(uint32_t)) ||
+        !get(&type.size, sizeof(uint32_t)) || !get(&length, sizeof(uint32_t)))
+      return false;
+    type.name.resize(length);
+    if (!get(type.name.data(), length))
+      return false;
+  }
+  trace.threads.resize(num_threads);
+  for (TraceFile::Thread &thread : trace.threads) {
+    uint32_t unused = 0;
+    uint64_t num_events = 0;
+    if (!get(&thread.index, sizeof(uint32_t)) ||
+        !get(&unused, sizeof(uint32_t)) || !get(&num_events, sizeof(uint64_t)))
+      return false;
+    thread.events.resize(num_events);
+    if (!get(thread.events.data(), num_events * sizeof(TraceEvent)))
+      return false;
+  }
+  return true;
+}
+
+inline void EventTrace::WriteChromeJson(const TraceFile &trace,
+                                        std::ostream &out) {
+  static constexpr const char *kKindNames[] = {"New", "Delete", "Collect",
+                                               "NewChunk"};
+  std::unordered_map<uint32_t, const TraceFile::Type *> types;
+  for (const TraceFile::Type &type : trace.types)
+    types[type.id] = &type;
+  auto type_name = [&types](uint32_t id) -> std::string {
+    auto it = types.find(id);
+    if (it == types.end())
+      return "?";
+    std::string escaped;
+    for (char c : it->second->name) {
+      if (c == '"' || c == '\\')
+        escaped += '\\';
+      escaped += c;
+    }
+    return escaped;
+  };
+  auto micros = [&trace](uint64_t ticks) {
+    int64_t delta = (int64_t)(ticks - trace.start_ticks);
+    return (double)delta * trace.ns_per_tick / 1000.0;
+  };
+
+  char line[256];
+  bool first = true;
+  auto begin_event = [&out, &first]() {
+    out << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (const TraceFile::Thread &thread : trace.threads) {
+    begin_event();
+    snprintf(line, sizeof(line),
+             "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,"
+             "\"args\":{\"name\":\"thread %u\"}}",
+             thread.index, thread.index);
+    out << line;
+  }
+
+  // Live blocks per type, in the order the events of all threads happened.
+  struct Ref {
+    const TraceEvent *event;
+    uint32_t tid;
+  };
+  std::vector<Ref> all;
+  for (const TraceFile::Thread &thread : trace.threads) {
+    for (const TraceEvent &event : thread.events)
+      all.push_back({&event, thread.index});
+  }
+  std::stable_sort(all.begin(), all.end(), [](const Ref &a, const Ref &b) {
+    return a.event->ticks < b.event->ticks;
+  });
+  std::unordered_map<uint32_t, int64_t> live;
+
+  for (const Ref &ref : all) {
+    const TraceEvent &e = *ref.event;
+    size_t kind = (size_t)e.kind;
+    if (kind >= std::size(kKindNames))
+      continue;
+    std::string name = type_name(e.type);
+    double ts = micros(e.ticks);
+    begin_event();
+    snprintf(line, sizeof(line),
+             "{\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,"
+             "\"name\":\"%s\",\"cat\":\"",
+             ref.tid, ts, kKindNames[kind]);
+    out << line << name;
+    snprintf(line, sizeof(line),
+             "\",\"args\":{\"ptr\":\"0x%llx\",\"chunk\":\"0x%llx\","
+             "\"remote\":%s}}",
+             (unsigned long long)e.ptr, (unsigned long long)e.chunk,
+             (e.flags & kTraceRemote) ? "true" : "false");
+    out << line;
+
+    int64_t &count = live[e.type];
+    if (e.kind == TraceKind::kNew)
+      count++;
+    else if (e.kind == TraceKind::kDelete)
+      count--;
+    else
+      continue;
+    begin_event();
+    snprintf(line, sizeof(line),
+             "{\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"name\":\"live ", ts);
+    out << line << name;
+    snprintf(line, sizeof(line), "\",\"args\":{\"blocks\":%lld}}",
+             (long long)count);
+    out << line;
+  }
+  out << "\n]}\n";
+}
+}; // namespace pool
+
+#endif //__EVENT_TRACE_H__
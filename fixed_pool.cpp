@@ -1,33 +1,184 @@
 #include "fixed_pool.h"
 
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 
-static inline bool IsAligned(size_t val, size_t alignment) {
-  size_t lowBits = val & (alignment - 1);
-  return (lowBits == 0);
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define FIXED_POOL_HAS_MMAP 1
+#endif
+
+#if defined(__linux__)
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define FIXED_POOL_HAS_NUMA 1
+#endif
+
+int NumaTopology::NumNodes() {
+  int num_nodes = num_nodes_.load(std::memory_order_relaxed);
+  if (num_nodes != 0)
+    return num_nodes;
+  // Threads asking at once all ask the system, the first store wins.
+  int expected = 0;
+  num_nodes = SystemNumNodes();
+  if (!num_nodes_.compare_exchange_strong(expected, num_nodes,
+                                          std::memory_order_relaxed))
+    return expected;
+  return num_nodes;
 }
 
-static inline size_t Align(size_t val, size_t alignment) {
-  assert((alignment & (alignment - 1)) == 0 &&
-         "Invalid alignment. Must be power of two.");
-  size_t r = (val + (alignment - 1)) & ~(alignment - 1);
-  assert(IsAligned(r, alignment) && "Alignment failed.");
-  return r;
+void NumaTopology::SetProvider(CurrentNodeFn current_node, int num_nodes) {
+  if (current_node == nullptr) {
+    current_node_.store(&SystemCurrentNode, std::memory_order_relaxed);
+    num_nodes_.store(0, std::memory_order_relaxed);
+    return;
+  }
+  current_node_.store(current_node, std::memory_order_relaxed);
+  num_nodes_.store(num_nodes, std::memory_order_relaxed);
+}
+
+int NumaTopology::SystemCurrentNode() {
+#ifdef FIXED_POOL_HAS_NUMA
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    return (int)node;
+#endif
+  return 0;
+}
+
+int NumaTopology::SystemNumNodes() {
+  int num_nodes = 1;
+#ifdef FIXED_POOL_HAS_NUMA
+  // Looks like "0" or "0-1".
+  if (FILE *f = fopen("/sys/devices/system/node/possible", "r")) {
+    int first = 0, last = 0;
+    int n = fscanf(f, "%d-%d", &first, &last);
+    if (n == 2)
+      num_nodes = last + 1;
+    else if (n == 1)
+      num_nodes = first + 1;
+    fclose(f);
+  }
+#endif
+  return num_nodes;
+}
+
+#if defined(FIXED_POOL_HAS_MMAP) && defined(FIXED_POOL_HAS_NUMA)
+// Prefers `numa_node` for the pages of the range, the kernel falls back to
+// other nodes when it runs out of memory. Failing is fine, e.g. the node
+// doesn't exist.
+static void BindToNode(void *p, size_t size, int numa_node) {
+  constexpr size_t kMaskBits = sizeof(unsigned long) * 8;
+  if (numa_node < 0 || (size_t)numa_node >= kMaskBits ||
+      NumaTopology::NumNodes() <= 1)
+    return;
+  unsigned long mask = 1UL << numa_node;
+  (void)syscall(SYS_mbind, p, size, MPOL_PREFERRED, &mask, kMaskBits, 0);
+}
+#endif
+
+#ifdef FIXED_POOL_HAS_MMAP
+// Over-reserves by `alignment` and unmaps the unaligned head and the tail.
+static void *MapAligned(size_t size, size_t alignment, int flags) {
+  size_t reserve = alignment > kPageSize ? size + alignment : size;
+  void *p = mmap(nullptr, reserve, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  if (p == MAP_FAILED)
+    return nullptr;
+
+  uintptr_t start = FixedPool::Align((uintptr_t)p, alignment);
+  size_t head = start - (uintptr_t)p;
+  size_t tail = reserve - head - size;
+  if (head > 0)
+    munmap(p, head);
+  if (tail > 0)
+    munmap((void *)(start + size), tail);
+
+  return (void *)start;
+}
+#endif
+
+void *FixedPool::AllocateChunk(size_t chunk_size, size_t chunk_alignment,
+                               ChunkBacking backing, int numa_node) {
+  assert(IsAligned(chunk_alignment, chunk_alignment) &&
+         "Invalid chunk alignment. Must be power of two.");
+#ifdef FIXED_POOL_HAS_MMAP
+  if (backing != ChunkBacking::kHeap) {
+    size_t page_size = BackingPageSize(backing);
+    size_t size = Align(chunk_size, page_size);
+    size_t alignment =
+        chunk_alignment < page_size ? page_size : chunk_alignment;
+
+    void *chunk = nullptr;
+    if (backing == ChunkBacking::kHugePages) {
+#ifdef MAP_HUGETLB
+      chunk = MapAligned(size, alignment, MAP_HUGETLB);
+#endif
+      if (chunk == nullptr) {
+        // No reserved huge pages, let transparent huge pages back it.
+        chunk = MapAligned(size, alignment, 0);
+#ifdef MADV_HUGEPAGE
+        if (chunk != nullptr)
+          madvise(chunk, size, MADV_HUGEPAGE);
+#endif
+      }
+    } else {
+      chunk = MapAligned(size, alignment, 0);
+    }
+
+    if (chunk == nullptr)
+      throw std::bad_alloc();
+#ifdef FIXED_POOL_HAS_NUMA
+    BindToNode(chunk, size, numa_node);
+#endif
+    return chunk;
+  }
+#else
+  (void)backing;
+#endif
+  (void)numa_node;
+  // Plain `operator new` already aligns this much, the aligned one would go
+  // through memalign.
+  if (chunk_alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    return ::operator new(chunk_size);
+  return ::operator new(chunk_size, std::align_val_t(chunk_alignment));
+}
+
+void FixedPool::FreeChunk(void *chunk, size_t chunk_size,
+                          size_t chunk_alignment, ChunkBacking backing) {
+#ifdef FIXED_POOL_HAS_MMAP
+  if (backing != ChunkBacking::kHeap) {
+    munmap(chunk, Align(chunk_size, BackingPageSize(backing)));
+    return;
+  }
+#else
+  (void)backing;
+#endif
+  if (chunk_alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    ::operator delete(chunk, chunk_size);
+  else
+    ::operator delete(chunk, chunk_size, std::align_val_t(chunk_alignment));
 }
 
 FixedPool *FixedPool::Create(size_t size_of_each_block,
                              uint32_t num_of_blocks) {
-  FixedPool *instance = new FixedPool();
-  instance->CreatePool(size_of_each_block, num_of_blocks);
+  size_t chunk_size = ChunkSize(
+      sizeof(FixedPool), BlockStride(size_of_each_block), num_of_blocks);
+  void *chunk = AllocateChunk(chunk_size, NextPowerOfTwo(chunk_size));
+  FixedPool *instance = new (chunk)
+      FixedPool((uintptr_t)chunk, BlocksStart(chunk, sizeof(FixedPool)),
+                BlockStride(size_of_each_block), num_of_blocks);
+  instance->chunk_size_ = chunk_size;
 
   return instance;
 }
 
 FixedPool *FixedPool::Create(uintptr_t id, size_t size_of_each_block,
                              uint32_t num_of_blocks) {
-  FixedPool *instance = new FixedPool(id);
-  instance->CreatePool(size_of_each_block, num_of_blocks);
+  FixedPool *instance = Create(size_of_each_block, num_of_blocks);
+  instance->id_ = id;
 
   return instance;
 }
@@ -36,90 +187,47 @@ FixedPool::FixedPool() : FixedPool((uintptr_t)this) {}
 
 FixedPool::FixedPool(uintptr_t id)
     : num_of_blocks_(0), size_of_each_block_(0), num_free_blocks_(0),
-      num_initialized_(0), pad_before_header_(0), mem_start_(nullptr),
-      next_(nullptr), id_(id) {}
+      num_initialized_(0), next_(0), thread_free_(kNoBlock),
+      mem_start_(nullptr), occupancy_(nullptr), id_(id), chunk_size_(0) {}
 
-FixedPool::~FixedPool() { DestroyPool(); }
+FixedPool::FixedPool(uintptr_t id, uchar *mem_start, size_t block_stride,
+                     uint32_t num_of_blocks)
+    : FixedPool(id) {
+  CreatePool(mem_start, block_stride, num_of_blocks);
+}
 
-void FixedPool::CreatePool(size_t size_of_each_block, uint32_t num_of_blocks) {
-  num_of_blocks_ = num_of_blocks;
+FixedPool::~FixedPool() { DestroyPool(); }
 
-  size_t size_of_each_block_with_header = sizeof(Header) + size_of_each_block;
-  size_t alignedSizeOfEachBlock =
-      Align(size_of_each_block_with_header, kMinAlignment);
-  pad_before_header_ = alignedSizeOfEachBlock - size_of_each_block_with_header;
-  size_of_each_block_ = alignedSizeOfEachBlock;
+void FixedPool::operator delete(FixedPool *p, std::destroying_delete_t) {
+  size_t chunk_size = p->chunk_size_;
+  assert(chunk_size != 0 && "Only `FixedPool::Create`d pools can be deleted.");
+  p->~FixedPool();
+  FreeChunk(p, chunk_size, NextPowerOfTwo(chunk_size));
+}
 
-  mem_start_ = new uchar[size_of_each_block_ * num_of_blocks_];
+void FixedPool::CreatePool(uchar *mem_start, size_t block_stride,
+                           uint32_t num_of_blocks) {
+  assert(block_stride == BlockStride(block_stride) &&
+         "Block stride must be able to hold a free block index.");
+  num_of_blocks_ = num_of_blocks;
+  size_of_each_block_ = block_stride;
+  mem_start_ = mem_start;
+  occupancy_ = (uint64_t *)Align(
+      (uintptr_t)(mem_start_ + block_stride * num_of_blocks), sizeof(uint64_t));
   ReclaimAll();
 }
 
 void FixedPool::DestroyPool() {
-  delete[] mem_start_;
+  // The blocks are part of the chunk, whoever allocated the chunk frees it.
   mem_start_ = nullptr;
+  occupancy_ = nullptr;
 }
 
-void *FixedPool::ForcedAllocate() {
-  if (num_initialized_ < num_of_blocks_) {
-    Header *h = (Header *)AddrFromIndex(num_initialized_);
-    h->next_block_idx = num_initialized_ + 1;
-    h->pool_identifier = id_;
-    num_initialized_++;
-  }
-  void *ret = ToData(next_);
-
-  --num_free_blocks_;
-  if (num_free_blocks_ != 0) {
-    uint32_t &next_idx = ((Header *)next_)->next_block_idx;
-
-    next_ = AddrFromIndex(next_idx);
-
-    // Marking as used..
-    next_idx = num_of_blocks_ + 1;
-  } else {
-    next_ = nullptr;
-  }
-
-  return ret;
-}
-
-void *FixedPool::Allocate() {
-  if (num_free_blocks_ == 0) {
-    return nullptr;
-  }
-  return ForcedAllocate();
-}
-
-void FixedPool::ForcedDeAllocate(void *p) {
-  Header *h = ReadHeader(p);
-
-  if (next_ != nullptr) {
-    h->next_block_idx = IndexFromAddr(next_);
-    // block = [(padding)(header)(data)]
-    // next_ = &((header)(data))
-    next_ = (uchar *)h;
-  } else {
-    // Doesn't matter what we set the next block index it kind of acts like the
-    // end block
-    h->next_block_idx = num_of_blocks_;
-    next_ = (uchar *)h;
-  }
-  ++num_free_blocks_;
-}
-
-void FixedPool::DeAllocate(void *p) {
-  Header *h = ReadHeader(p);
-  if (h->pool_identifier != id_)
-    return;
-
-  ForcedDeAllocate(p);
-}
-
-inline void FixedPool::ReclaimAll() {
+void FixedPool::ReclaimAll() {
   num_initialized_ = 0;
   num_free_blocks_ = num_of_blocks_;
-  std::memset(mem_start_, 0xf,
-              size_of_each_block_ * num_free_blocks_ * sizeof(uchar));
+  // Blocks get their free list index lazily, only the bitmap needs resetting.
+  std::memset(occupancy_, 0, OccupancyWords(num_of_blocks_) * sizeof(uint64_t));
 
-  next_ = (uchar *)AddrFromIndex(0);
+  next_ = 0;
 }
@@ -1,84 +1,553 @@
+#ifndef __FIXED_POOL_H__
+#define __FIXED_POOL_H__
+
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
 
 #ifndef FIXED_POOL_BLOCK_COUNT
 #define FIXED_POOL_BLOCK_COUNT 64
 #endif
 
+#ifndef FIXED_POOL_MAX_BLOCK_COUNT
+#define FIXED_POOL_MAX_BLOCK_COUNT 16384
+#endif
+
+// Biggest heap backed `Pool<T>` chunk by default, see `kMaxHeapChunkSize`.
+#ifndef FIXED_POOL_MAX_HEAP_CHUNK
+#define FIXED_POOL_MAX_HEAP_CHUNK (64 * 1024)
+#endif
+
+#ifndef FIXED_POOL_RELEASE_INTERVAL
+#define FIXED_POOL_RELEASE_INTERVAL 4096
+#endif
+
 constexpr size_t kMinAlignment = 4;
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kPageSize = 4096;
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
 constexpr size_t kDefaultBlockCount = FIXED_POOL_BLOCK_COUNT;
+constexpr size_t kDefaultMaxBlockCount = FIXED_POOL_MAX_BLOCK_COUNT;
+constexpr size_t kDefaultReleaseInterval = FIXED_POOL_RELEASE_INTERVAL;
+constexpr size_t kDefaultMaxHeapChunkSize = FIXED_POOL_MAX_HEAP_CHUNK;
 constexpr size_t kStackConsumeItems = 16;
 
+// How the blocks of a pool are laid out against cache lines.
+enum class StrideMode {
+  kPacked,              // Blocks are only aligned to the object's alignment
+  kNoCacheLineStraddle, // No block crosses a cache line boundary
+  kWholeCacheLines,     // Every block owns whole cache lines
+};
+
+// Where the chunks get their memory from.
+enum class ChunkBacking {
+  kHeap,      // Aligned `operator new`
+  kMmap,      // Anonymous `mmap`, rounded up to whole pages
+  kHugePages, // `MAP_HUGETLB` if the system has reserved huge pages, otherwise
+              // `mmap` + `madvise(MADV_HUGEPAGE)`, rounded up to whole 2 MiB
+              // pages
+};
+
+// NUMA node of the calling thread and how many nodes the machine has. Asks the
+// kernel by default, tests can install a fake provider to pretend the machine
+// has more nodes. Set it before any pool is used.
+class NumaTopology {
+public:
+  using CurrentNodeFn = int (*)();
+
+  static int CurrentNode() {
+    return current_node_.load(std::memory_order_relaxed)();
+  }
+  static int NumNodes();
+
+  // `nullptr` restores the system provider, `num_nodes` is then ignored.
+  static void SetProvider(CurrentNodeFn current_node, int num_nodes);
+
+private:
+  static int SystemCurrentNode();
+  static int SystemNumNodes();
+
+  // Any thread reads them, `NumNodes` fills `num_nodes_` on first use.
+  static inline std::atomic<CurrentNodeFn> current_node_{&SystemCurrentNode};
+  static inline std::atomic<int> num_nodes_{0}; // 0 until asked
+};
+
+template <size_t BlockSize, uint32_t BlockCount, size_t Alignment>
+class StaticFixedPool;
+
+// A chunk is one allocation aligned to a power of two at least its size:
+//   chunk = [(metadata)(padding)(block 0)(block 1)...(block n - 1)]
+// The metadata(the `FixedPool` itself or some wrapper around it) lives at the
+// chunk base, so the owner of any block can be found by masking the block's
+// address with the chunk alignment. Blocks don't carry any header, a free block
+// stores the index of the next free block in its own storage. The chunk ends
+// with an occupancy bitmap, one bit per block, so scanning the used blocks
+// skips whole empty 64 block words:
+//   chunk = [...(block n - 1)(padding)(occupancy bitmap)]
 class FixedPool {
   template <typename T> friend class Pool;
   template <typename T> friend class PoolManager;
+  template <size_t, uint32_t, size_t> friend class StaticFixedPool;
 
 private:
   using uchar = unsigned char;
-  struct Header {
-    uintptr_t pool_identifier;
-    uint32_t next_block_idx;
-  };
 
-  inline uchar *AddrFromIndex(uint32_t i) const {
-    // block = [(padding)(header)(data)]
-    // returns &((header)(data))
-    return (mem_start_ + (i * size_of_each_block_)) + pad_before_header_;
+  // `Stride` is the compile-time block stride if the caller knows it, it
+  // turns the index math into shifts/multiplications, 0 means the runtime one.
+  template <size_t Stride = 0> inline size_t GetStride() const {
+    if constexpr (Stride != 0)
+      return Stride;
+    else
+      return size_of_each_block_;
   }
 
+  template <size_t Stride = 0> inline uchar *AddrFromIndex(uint32_t i) const {
+    return mem_start_ + (i * GetStride<Stride>());
+  }
+
+  template <size_t Stride = 0>
   inline uint32_t IndexFromAddr(const uchar *p) const {
-    // [(padding)(header)(data)]
-    // p = &((header)(data))
-    return (((uint32_t)((p - pad_before_header_) - mem_start_)) /
-            (uint32_t)size_of_each_block_);
+    return ((uint32_t)(p - mem_start_)) / (uint32_t)GetStride<Stride>();
+  }
+
+  static inline uint32_t &NextIndex(void *p) {
+    return *reinterpret_cast<uint32_t *>(p);
+  }
+
+  // Padded to groups of four words, see `ForEachUsedBlock`.
+  static constexpr size_t OccupancyWords(uint32_t num_of_blocks) {
+    return ((num_of_blocks + 255) / 256) * 4;
+  }
+
+  inline void MarkUsed(uint32_t i) {
+    occupancy_[i / 64] |= (uint64_t)1 << (i % 64);
+  }
+
+  inline void MarkFree(uint32_t i) {
+    occupancy_[i / 64] &= ~((uint64_t)1 << (i % 64));
   }
 
-  static inline Header *ReadHeader(void *p) {
-    Header *h = reinterpret_cast<Header *>(reinterpret_cast<char *>(p) -
-                                           sizeof(Header));
-    return h;
+  // Marks `count` blocks starting from `first` as used, a word at a time.
+  inline void MarkUsedRange(uint32_t first, uint32_t count) {
+    while (count > 0) {
+      uint32_t bit = first % 64;
+      uint32_t bits = 64 - bit < count ? 64 - bit : count;
+      uint64_t mask = bits == 64 ? ~(uint64_t)0 : (((uint64_t)1 << bits) - 1);
+      occupancy_[first / 64] |= mask << bit;
+      first += bits;
+      count -= bits;
+    }
   }
 
   FixedPool();
   FixedPool(uintptr_t id);
-  void CreatePool(size_t size_of_each_block, uint32_t num_of_blocks);
+  FixedPool(uintptr_t id, uchar *mem_start, size_t block_stride,
+            uint32_t num_of_blocks);
+  void CreatePool(uchar *mem_start, size_t block_stride,
+                  uint32_t num_of_blocks);
   void DestroyPool();
-  void *ForcedAllocate();
-  void ForcedDeAllocate(void *p);
+  template <size_t Stride = 0> inline void *ForcedAllocate();
+  template <size_t Stride = 0> inline void ForcedDeAllocate(void *p);
+
+  // Marks the end of the thread-free list.
+  static constexpr uint32_t kNoBlock = UINT32_MAX;
+
+  // Links `p` to `next` through `p`'s storage, to build a chain of blocks
+  // for `PushThreadFree`.
+  template <size_t Stride = 0> inline void LinkBlocks(void *p, void *next) {
+    NextIndex(p) = IndexFromAddr<Stride>((uchar *)next);
+  }
+
+  // Pushes the chain of used blocks `first`...`last` to the thread-free list,
+  // callable from any thread. Returns true if the list was empty, so exactly
+  // one pusher finds out the owner has something new to collect.
+  template <size_t Stride = 0>
+  inline bool PushThreadFree(void *first, void *last);
+
+  // Owner only, takes the whole thread-free list with one exchange and frees
+  // every block on it. Returns how many blocks got freed.
+  template <size_t Stride = 0> inline uint32_t CollectThreadFree();
 
 private:
-  uint32_t num_of_blocks_;     // Num of blocks
-  size_t size_of_each_block_;  // Size of each block
-  uint32_t num_free_blocks_;   // Num of remaining blocks
-  uint32_t num_initialized_;   // Num of initialized blocks
-  uint32_t pad_before_header_; // Extra bytes allocated for alignment
-  uchar *mem_start_;           // Beginning of memory pool
-  uchar *next_;                // Num of next free block
-  uintptr_t id_;               // Assigned id
+  uint32_t num_of_blocks_;    // Num of blocks
+  size_t size_of_each_block_; // Size of each block
+  uint32_t num_free_blocks_;  // Num of remaining blocks
+  uint32_t num_initialized_;  // Num of initialized blocks
+  uint32_t next_;             // Num of next free block
+  // Blocks freed by other threads, linked through their storage like the
+  // free list but still marked used until the owner collects them.
+  std::atomic<uint32_t> thread_free_;
+  uchar *mem_start_;          // Beginning of memory pool
+  uint64_t *occupancy_;       // One bit per block, set if used
+  uintptr_t id_;              // Assigned id
+  size_t chunk_size_;         // Size of the owned chunk, 0 if embedded
 
 public:
+  static constexpr bool IsAligned(size_t val, size_t alignment) {
+    return (val & (alignment - 1)) == 0;
+  }
+
+  static constexpr size_t Align(size_t val, size_t alignment) {
+    return (val + (alignment - 1)) & ~(alignment - 1);
+  }
+
+  static constexpr size_t NextPowerOfTwo(size_t val) {
+    size_t r = 1;
+    while (r < val)
+      r <<= 1;
+    return r;
+  }
+
+  // Alignment of the first block, the cache line modes start the blocks at a
+  // cache line so the stride alone keeps them off the line boundaries.
+  static constexpr size_t
+  BlockAlignment(size_t alignment, StrideMode mode = StrideMode::kPacked) {
+    size_t r = alignment < kMinAlignment ? kMinAlignment : alignment;
+    if (mode != StrideMode::kPacked && r < kCacheLineSize)
+      r = kCacheLineSize;
+    return r;
+  }
+
+  // Every block must at least be able to hold the next free block index.
+  static constexpr size_t BlockStride(size_t size_of_each_block,
+                                      size_t alignment = kMinAlignment,
+                                      StrideMode mode = StrideMode::kPacked) {
+    size_t r = Align(size_of_each_block < sizeof(uint32_t) ? sizeof(uint32_t)
+                                                           : size_of_each_block,
+                     alignment < kMinAlignment ? kMinAlignment : alignment);
+    switch (mode) {
+    case StrideMode::kPacked:
+      return r;
+    case StrideMode::kNoCacheLineStraddle:
+      // Powers of two below a cache line divide it, so starting from a cache
+      // line aligned block no block crosses a line.
+      return r <= kCacheLineSize ? NextPowerOfTwo(r)
+                                 : Align(r, kCacheLineSize);
+    case StrideMode::kWholeCacheLines:
+      return Align(r, kCacheLineSize);
+    }
+    return r;
+  }
+
+  // Size of a chunk which places `meta_size` bytes of metadata right before
+  // `num_of_blocks` blocks of `block_stride` bytes and their bitmap.
+  static constexpr size_t ChunkSize(size_t meta_size, size_t block_stride,
+                                    uint32_t num_of_blocks,
+                                    size_t block_alignment = kMinAlignment) {
+    return Align(Align(meta_size, block_alignment) +
+                     block_stride * num_of_blocks,
+                 sizeof(uint64_t)) +
+           OccupancyWords(num_of_blocks) * sizeof(uint64_t);
+  }
+
+  // Most blocks fitting a chunk of `chunk_size` bytes.
+  static constexpr uint32_t BlocksFitting(size_t chunk_size, size_t meta_size,
+                                          size_t block_stride,
+                                          size_t block_alignment) {
+    size_t blocks_offset = Align(meta_size, block_alignment);
+    // Every block takes its stride plus one bit, with the padding and a
+    // partial bitmap group kept out.
+    size_t spare = 5 * sizeof(uint64_t);
+    if (chunk_size < blocks_offset + spare)
+      return 0;
+    size_t blocks =
+        (chunk_size - blocks_offset - spare) * 8 / (block_stride * 8 + 1);
+    while (ChunkSize(meta_size, block_stride, (uint32_t)blocks + 1,
+                     block_alignment) <= chunk_size)
+      blocks++;
+    return (uint32_t)blocks;
+  }
+
+  static inline uchar *BlocksStart(void *chunk, size_t meta_size,
+                                   size_t block_alignment = kMinAlignment) {
+    return (uchar *)chunk + Align(meta_size, block_alignment);
+  }
+
+  static inline void *ChunkFromAddr(const void *p, size_t chunk_alignment) {
+    return (void *)((uintptr_t)p & ~(uintptr_t)(chunk_alignment - 1));
+  }
+
+  // Granularity of the memory behind a chunk, callers can grow their chunks
+  // to a multiple of it for free.
+  static constexpr size_t BackingPageSize(ChunkBacking backing) {
+    switch (backing) {
+    case ChunkBacking::kHeap:
+      return 1;
+    case ChunkBacking::kMmap:
+      return kPageSize;
+    case ChunkBacking::kHugePages:
+      return kHugePageSize;
+    }
+    return 1;
+  }
+
+  // `chunk_alignment` is a power of two, callers finding chunks by masking
+  // pass one at least `chunk_size`. Page backed chunks are bound to
+  // `numa_node` if it is not -1, best effort. Heap chunks are placed by the
+  // kernel when first touched, which is the allocating thread for pool chunks.
+  static void *AllocateChunk(size_t chunk_size, size_t chunk_alignment,
+                             ChunkBacking backing = ChunkBacking::kHeap,
+                             int numa_node = -1);
+  static void FreeChunk(void *chunk, size_t chunk_size, size_t chunk_alignment,
+                        ChunkBacking backing = ChunkBacking::kHeap);
+
   static FixedPool *Create(size_t size_of_each_block, uint32_t num_of_blocks);
   static FixedPool *Create(uintptr_t id, size_t size_of_each_block,
                            uint32_t num_of_blocks);
 
   ~FixedPool();
 
-  void *Allocate();
-  void DeAllocate(void *p);
+  // `FixedPool::Create`d pools share their chunk with the blocks.
+  void operator delete(FixedPool *p, std::destroying_delete_t);
+
+  inline void *Allocate();
+
+  // Allocates up to `n` blocks into `out` and returns how many it got, only
+  // fewer than `n` if the pool ran out of free blocks. Freed blocks are taken
+  // from the free list first, the rest is one run of untouched blocks.
+  template <size_t Stride = 0, typename U = void>
+  inline uint32_t AllocateBatch(uint32_t n, U **out);
+  inline void DeAllocate(void *p);
   void ReclaimAll();
 
   uint32_t GetNumOfBlocks() const { return num_of_blocks_; }
+  uint32_t GetNumOfFreeBlocks() const { return num_free_blocks_; }
+  size_t GetBlockStride() const { return size_of_each_block_; }
   uintptr_t GetId() const { return id_; }
-  inline void *ToData(uchar *p) {
-    return (void *)((size_t)(p) + sizeof(Header));
-  }
   bool IsAnyBlockAvailable() const { return num_free_blocks_ > 0; }
   bool IsAnyBlockUsed() const {
     return (num_of_blocks_ - num_free_blocks_) > 0;
   }
-  bool IsBlockUsed(size_t block_idx) const {
-    return next_ == nullptr ||
-           ((Header *)AddrFromIndex(block_idx))->next_block_idx ==
-               num_of_blocks_ + 1;
+  bool Contains(const void *p) const {
+    return (const uchar *)p >= mem_start_ &&
+           (const uchar *)p < AddrFromIndex(num_of_blocks_);
+  }
+
+  // Calls `fn(void *block)` for every used block, only reads the bitmap and
+  // stops once no block is used. `fn` may free blocks, the ones it frees
+  // before they are reached are skipped.
+  template <typename Fn> void ForEachUsedBlock(Fn &&fn) const;
+
+  // Calls `fn(void *block)` for every used block and frees it right after,
+  // costs time proportional to the used blocks rather than the capacity.
+  // `fn` may free other blocks, e.g. a destructor deleting the objects it
+  // owns, those are skipped. Rewinds the pool once every block is free.
+  template <typename Fn> void ReclaimAll(Fn &&fn);
+};
+
+// The allocation hot path lives in the header so it inlines into `Pool<T>`.
+template <size_t Stride> inline void *FixedPool::ForcedAllocate() {
+  if (num_initialized_ < num_of_blocks_) {
+    NextIndex(AddrFromIndex<Stride>(num_initialized_)) = num_initialized_ + 1;
+    num_initialized_++;
+  }
+  uint32_t idx = next_;
+  uchar *ret = AddrFromIndex<Stride>(idx);
+  MarkUsed(idx);
+
+  --num_free_blocks_;
+  // Doesn't matter what the next index of the last block is, it is never
+  // followed when there are no free blocks left.
+  next_ = NextIndex(ret);
+
+  return ret;
+}
+
+inline void *FixedPool::Allocate() {
+  if (num_free_blocks_ == 0) {
+    return nullptr;
+  }
+  return ForcedAllocate();
+}
+
+template <size_t Stride> inline void FixedPool::ForcedDeAllocate(void *p) {
+  uint32_t idx = IndexFromAddr<Stride>((uchar *)p);
+  MarkFree(idx);
+
+  NextIndex(p) = next_;
+  next_ = idx;
+  ++num_free_blocks_;
+}
+
+inline void FixedPool::DeAllocate(void *p) {
+  if (!Contains(p))
+    return;
+
+  ForcedDeAllocate(p);
+}
+
+template <size_t Stride>
+inline bool FixedPool::PushThreadFree(void *first, void *last) {
+  uint32_t head = thread_free_.load(std::memory_order_relaxed);
+  uint32_t first_idx = IndexFromAddr<Stride>((uchar *)first);
+  do {
+    NextIndex(last) = head;
+  } while (!thread_free_.compare_exchange_weak(head, first_idx,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed));
+  return head == kNoBlock;
+}
+
+template <size_t Stride> inline uint32_t FixedPool::CollectThreadFree() {
+  // Pops never happen, the owner only swaps the whole list out, so there is
+  // no ABA to guard against.
+  uint32_t idx = thread_free_.exchange(kNoBlock, std::memory_order_acq_rel);
+  uint32_t count = 0;
+  while (idx != kNoBlock) {
+    uchar *p = AddrFromIndex<Stride>(idx);
+    uint32_t next = NextIndex(p);
+    ForcedDeAllocate<Stride>(p);
+    idx = next;
+    count++;
+  }
+  return count;
+}
+
+template <size_t Stride, typename U>
+inline uint32_t FixedPool::AllocateBatch(uint32_t n, U **out) {
+  uint32_t count = n < num_free_blocks_ ? n : num_free_blocks_;
+  uint32_t i = 0;
+
+  // Blocks before the lazily initialized frontier are linked, the frontier
+  // and everything after it hasn't been touched yet.
+  uint32_t next = next_;
+  while (i < count && next != num_initialized_) {
+    uchar *p = AddrFromIndex<Stride>(next);
+    MarkUsed(next);
+    next = NextIndex(p);
+    out[i++] = (U *)p;
+  }
+
+  if (i < count) {
+    uint32_t run = count - i;
+    for (uint32_t k = 0; k < run; k++)
+      out[i + k] = (U *)AddrFromIndex<Stride>(next + k);
+    MarkUsedRange(next, run);
+    num_initialized_ += run;
+    next = num_initialized_;
+  }
+
+  next_ = next;
+  num_free_blocks_ -= count;
+  return count;
+}
+
+// Both scans go over groups of four bitmap words(256 blocks), an empty group
+// is skipped with a single test which compilers turn into one vector
+// instruction. The bitmap is padded to whole groups. A word is read again
+// after every `fn` call, starting past the block just visited.
+template <typename Fn> void FixedPool::ForEachUsedBlock(Fn &&fn) const {
+  uint32_t num_words = OccupancyWords(num_of_blocks_);
+  for (uint32_t group = 0; group < num_words && IsAnyBlockUsed();
+       group += 4) {
+    const uint64_t *words = occupancy_ + group;
+    if ((words[0] | words[1] | words[2] | words[3]) == 0)
+      continue;
+    for (uint32_t i = 0; i < 4; i++) {
+      uint32_t base = (group + i) * 64;
+      uint64_t word = words[i];
+      while (word != 0) {
+        uint32_t bit = (uint32_t)__builtin_ctzll(word);
+        fn((void *)AddrFromIndex(base + bit));
+        word = bit == 63 ? 0 : words[i] & (~(uint64_t)0 << (bit + 1));
+      }
+    }
+  }
+}
+
+template <typename Fn> void FixedPool::ReclaimAll(Fn &&fn) {
+  uint32_t num_words = OccupancyWords(num_of_blocks_);
+  for (uint32_t group = 0; group < num_words && IsAnyBlockUsed();
+       group += 4) {
+    uint64_t *words = occupancy_ + group;
+    if ((words[0] | words[1] | words[2] | words[3]) == 0)
+      continue;
+    for (uint32_t i = 0; i < 4; i++) {
+      uint32_t base = (group + i) * 64;
+      for (uint64_t word = words[i]; word != 0; word = words[i]) {
+        void *p = AddrFromIndex(base + (uint32_t)__builtin_ctzll(word));
+        fn(p);
+        ForcedDeAllocate(p);
+      }
+    }
+  }
+
+  if (!IsAnyBlockUsed()) {
+    num_initialized_ = 0;
+    next_ = 0;
+  }
+}
+
+// `FixedPool` with every size known at compile time, the blocks and the
+// occupancy bitmap live inside the object itself:
+//   StaticFixedPool<sizeof(MyObj), 64, alignof(MyObj)> pool;
+//   MyObj *obj = new (pool.Allocate()) MyObj(...);
+template <size_t BlockSize, uint32_t BlockCount,
+          size_t Alignment = kMinAlignment>
+class StaticFixedPool {
+private:
+  using uchar = unsigned char;
+
+  static constexpr size_t kAlignment = FixedPool::BlockAlignment(Alignment);
+  static constexpr size_t kStride =
+      FixedPool::BlockStride(BlockSize, Alignment);
+
+  static_assert(BlockCount > 0, "Pool must have at least one block.");
+
+  // Blocks, padding and bitmap, laid out the way `FixedPool::CreatePool`
+  // expects them.
+  static constexpr size_t kStorageSize =
+      FixedPool::Align(kStride * BlockCount, sizeof(uint64_t)) +
+      FixedPool::OccupancyWords(BlockCount) * sizeof(uint64_t);
+
+  alignas(kAlignment > alignof(uint64_t) ? kAlignment : alignof(uint64_t))
+      uchar storage_[kStorageSize];
+  FixedPool pool_;
+
+public:
+  StaticFixedPool() : pool_((uintptr_t)this, storage_, kStride, BlockCount) {}
+
+  StaticFixedPool(const StaticFixedPool &) = delete;
+  StaticFixedPool &operator=(const StaticFixedPool &) = delete;
+
+  inline void *ForcedAllocate() { return pool_.ForcedAllocate<kStride>(); }
+
+  inline void *Allocate() {
+    if (!pool_.IsAnyBlockAvailable())
+      return nullptr;
+    return ForcedAllocate();
+  }
+
+  inline void ForcedDeAllocate(void *p) { pool_.ForcedDeAllocate<kStride>(p); }
+
+  inline void DeAllocate(void *p) {
+    if (!Contains(p))
+      return;
+
+    ForcedDeAllocate(p);
+  }
+
+  void ReclaimAll() { pool_.ReclaimAll(); }
+
+  // See `FixedPool::ForEachUsedBlock` and `FixedPool::ReclaimAll`.
+  template <typename Fn> void ForEachUsedBlock(Fn &&fn) const {
+    pool_.ForEachUsedBlock(std::forward<Fn>(fn));
+  }
+  template <typename Fn> void ReclaimAll(Fn &&fn) {
+    pool_.ReclaimAll(std::forward<Fn>(fn));
+  }
+
+  static constexpr uint32_t GetNumOfBlocks() { return BlockCount; }
+  static constexpr size_t GetStride() { return kStride; }
+  bool IsAnyBlockAvailable() const { return pool_.IsAnyBlockAvailable(); }
+  bool IsAnyBlockUsed() const { return pool_.IsAnyBlockUsed(); }
+  bool Contains(const void *p) const {
+    return (const uchar *)p >= storage_ &&
+           (const uchar *)p < storage_ + kStride * BlockCount;
   }
 };
+
+#endif // __FIXED_POOL_H__
@@ -0,0 +1,236 @@
+#ifndef __HEAP_PROFILER_H__
+#define __HEAP_PROFILER_H__
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define HEAP_PROFILER_HAS_BACKTRACE 1
+#endif
+
+#ifndef MEMORY_POOL_SAMPLING
+#define MEMORY_POOL_SAMPLING 1
+#endif
+
+// Bytes between samples on average, 0 keeps sampling off until
+// `HeapProfiler::SetSampleRate`.
+#ifndef MEMORY_POOL_SAMPLE_RATE
+#define MEMORY_POOL_SAMPLE_RATE 0
+#endif
+
+constexpr bool kHeapSampling = MEMORY_POOL_SAMPLING;
+
+namespace pool {
+// Sampling heap profiler of the blocks `Pool<T>` hands out, records the stack
+// of about one block every `SampleRate()` bytes:
+//   pool::HeapProfiler::SetSampleRate(512 * 1024);
+//   ...
+//   std::ofstream out("pool.heap");
+//   pool::HeapProfiler::WriteProfile(out); // pprof ./app pool.heap
+//
+// Every thread counts down the bytes it allocates, the countdown is redrawn
+// from an exponential distribution after every sample so each byte has the
+// same chance of being sampled, an allocation which isn't sampled costs one
+// thread-local decrement. Sampled blocks are kept in a global map until
+// they're deleted, their chunk marks them in a bitmap so deleting a block of
+// a chunk without any samples only costs a load of the chunk header. Magazine
+// types aren't sampled. `MEMORY_POOL_SAMPLING=0` compiles it out.
+class HeapProfiler {
+public:
+  static constexpr int kMaxFrames = 32;
+
+  // Bytes between samples on average, 0 turns sampling off. The calling
+  // thread uses the new rate right away, the others pick it up at their next
+  // sample, a thread not sampling checks again every `kDisabledRecheck` bytes.
+  static void SetSampleRate(size_t bytes) {
+    sample_rate_.store(bytes, std::memory_order_relaxed);
+    bytes_left_ = 0;
+  }
+
+  static size_t SampleRate() {
+    return sample_rate_.load(std::memory_order_relaxed);
+  }
+
+  // True when the calling thread's countdown ran out, the block should go to
+  // `Record`.
+  static inline bool ShouldSample(size_t bytes) {
+    if constexpr (!kHeapSampling)
+      return false;
+    bytes_left_ -= (int64_t)bytes;
+    return bytes_left_ < 0;
+  }
+
+  // Draws the next countdown and records `block` unless sampling just got
+  // turned on or off, returns whether it did. Never inlined, so the caller
+  // frames to skip are known.
+  [[gnu::noinline]] static bool Record(void *block, size_t size,
+                                       int skip_frames) {
+    size_t rate = SampleRate();
+    bool was_sampling = thread_rate_ != 0;
+    thread_rate_ = rate;
+    if (rate == 0) {
+      bytes_left_ = kDisabledRecheck;
+      return false;
+    }
+    bytes_left_ = NextCountdown(rate);
+    // Ran out of a countdown drawn while sampling was off.
+    if (!was_sampling)
+      return false;
+
+    Sample sample;
+    sample.size = size;
+    sample.depth = 0;
+#ifdef HEAP_PROFILER_HAS_BACKTRACE
+    void *frames[kMaxFrames + 4];
+    int skip = skip_frames + 1; // And this frame
+    int depth = backtrace(frames, kMaxFrames + 4);
+    for (int i = skip; i < depth && sample.depth < kMaxFrames; i++)
+      sample.frames[sample.depth++] = frames[i];
+#else
+    (void)skip_frames;
+#endif
+
+    Samples &samples = LiveSamples();
+    std::lock_guard<std::mutex> lock(samples.mutex);
+    samples.live[(uintptr_t)block] = sample;
+    return true;
+  }
+
+  // Drops the sample of a deleted block, returns whether there was one.
+  static bool Forget(void *block);
+
+  // Drops every sample in `[begin, begin + size)`, returns how many.
+  static size_t ForgetRange(void *begin, size_t size);
+
+  static size_t GetNumOfLiveSamples();
+
+  // Live samples in the legacy gperftools heap profile format pprof reads,
+  // grouped by stack, followed by `/proc/self/maps` for symbolization.
+  static void WriteProfile(std::ostream &out);
+
+private:
+  static constexpr int64_t kDisabledRecheck = 1024 * 1024;
+
+  struct Sample {
+    size_t size;
+    int depth;
+    void *frames[kMaxFrames];
+  };
+
+  struct Samples {
+    std::mutex mutex;
+    std::map<uintptr_t, Sample> live;
+  };
+
+  // Never destroyed, blocks are still deleted by the static destructors
+  // freeing the states of exited threads.
+  static Samples &LiveSamples() {
+    static Samples *samples = new Samples();
+    return *samples;
+  }
+
+  static int64_t NextCountdown(size_t rate);
+
+  static inline std::atomic<size_t> sample_rate_{MEMORY_POOL_SAMPLE_RATE};
+  static inline thread_local int64_t bytes_left_ = 0;
+  static inline thread_local size_t thread_rate_ = 0; // Last one drawn with
+  static inline thread_local uint64_t rng_ = 0;
+};
+
+inline int64_t HeapProfiler::NextCountdown(size_t rate) {
+  if (rng_ == 0)
+    rng_ = (uint64_t)(uintptr_t)&rng_ * 0x9E3779B97F4A7C15ull | 1;
+  // xorshift64*
+  rng_ ^= rng_ >> 12;
+  rng_ ^= rng_ << 25;
+  rng_ ^= rng_ >> 27;
+  uint64_t bits = (rng_ * 0x2545F4914F6CDD1Dull) >> 11;
+  // (0, 1], 53 bits.
+  double u = (double)(bits + 1) * (1.0 / 9007199254740992.0);
+  double next = -std::log(u) * (double)rate;
+  return next < 1.0 ? 1 : next > 4e18 ? (int64_t)4e18 : (int64_t)next;
+}
+
+inline bool HeapProfiler::Forget(void *block) {
+  Samples &samples = LiveSamples();
+  std::lock_guard<std::mutex> lock(samples.mutex);
+  return samples.live.erase((uintptr_t)block) != 0;
+}
+
+inline size_t HeapProfiler::ForgetRange(void *begin, size_t size) {
+  Samples &samples = LiveSamples();
+  std::lock_guard<std::mutex> lock(samples.mutex);
+  auto first = samples.live.lower_bound((uintptr_t)begin);
+  auto last = samples.live.lower_bound((uintptr_t)begin + size);
+  size_t count = (size_t)std::distance(first, last);
+  samples.live.erase(first, last);
+  return count;
+}
+
+inline size_t HeapProfiler::GetNumOfLiveSamples() {
+  Samples &samples = LiveSamples();
+  std::lock_guard<std::mutex> lock(samples.mutex);
+  return samples.live.size();
+}
+
+inline void HeapProfiler::WriteProfile(std::ostream &out) {
+  struct Bucket {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+  };
+  std::map<std::vector<void *>, Bucket> buckets;
+  Bucket total;
+  {
+    Samples &samples = LiveSamples();
+    std::lock_guard<std::mutex> lock(samples.mutex);
+    for (const auto &[block, sample] : samples.live) {
+      Bucket &bucket = buckets[std::vector<void *>(
+          sample.frames, sample.frames + sample.depth)];
+      bucket.count++;
+      bucket.bytes += sample.size;
+      total.count++;
+      total.bytes += sample.size;
+    }
+  }
+
+  // Only live blocks are kept, so the in-use and the allocated columns are
+  // the same. pprof scales the raw samples back up with the rate.
+  char line[128];
+  snprintf(line, sizeof(line), "heap profile: %llu: %llu [%llu: %llu] @ "
+           "heap_v2/%zu\n",
+           (unsigned long long)total.count, (unsigned long long)total.bytes,
+           (unsigned long long)total.count, (unsigned long long)total.bytes,
+           SampleRate());
+  out << line;
+  for (const auto &[frames, bucket] : buckets) {
+    snprintf(line, sizeof(line), "%llu: %llu [%llu: %llu] @",
+             (unsigned long long)bucket.count,
+             (unsigned long long)bucket.bytes,
+             (unsigned long long)bucket.count,
+             (unsigned long long)bucket.bytes);
+    out << line;
+    for (void *frame : frames) {
+      snprintf(line, sizeof(line), " %p", frame);
+      out << line;
+    }
+    out << "\n";
+  }
+
+  out << "\nMAPPED_LIBRARIES:\n";
+  if (FILE *maps = fopen("/proc/self/maps", "r")) {
+    size_t n;
+    while ((n = fread(line, 1, sizeof(line), maps)) > 0)
+      out.write(line, (std::streamsize)n);
+    fclose(maps);
+  }
+}
+}; // namespace pool
+
+#endif //__HEAP_PROFILER_H__
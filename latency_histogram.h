@@ -0,0 +1,286 @@
+#ifndef __LATENCY_HISTOGRAM_H__
+#define __LATENCY_HISTOGRAM_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LATENCY_HISTOGRAM_HAS_TSC 1
+#endif
+
+// Opt-in, every `Pool<T>` New/Delete is timed once this is 1.
+#ifndef MEMORY_POOL_LATENCY
+#define MEMORY_POOL_LATENCY 0
+#endif
+
+constexpr bool kLatencyHistograms = MEMORY_POOL_LATENCY;
+
+namespace pool {
+enum class LatencyOp : uint8_t { kNew, kDelete };
+
+// What a call had to do besides taking or returning one block.
+enum class LatencyPath : uint8_t {
+  kFast,    // The active chunk or the loaded magazine served it
+  kDrain,   // New: the active chunk ran out, remote frees were collected or
+            // the next free chunk taken. Delete: a buffer of remote frees was
+            // handed over. Either: magazines were swapped
+  kGrow,    // New: a chunk was added, from the depot or the system
+  kRelease, // Delete: ran the check releasing unused chunks
+};
+
+constexpr size_t kLatencyOps = 2;
+constexpr size_t kLatencyPaths = 4;
+
+// Log-linear(HDR style) histogram of tick counts. Values below `kSubBuckets`
+// get a bucket each, every power of two above is split into `kSubBuckets`
+// linear buckets, so a bucket is at most 1/16th of its values wide. Only the
+// owner thread records, with a relaxed load and store like `PoolCounters`,
+// any thread can read it.
+class LatencyHistogram {
+public:
+  static constexpr int kSubBits = 4;
+  static constexpr uint64_t kSubBuckets = 1 << kSubBits;
+  // Values from 2^(kMaxExponent + 1) on end up in the last bucket, `max`
+  // still has them right.
+  static constexpr int kMaxExponent = 40;
+  static constexpr size_t kBuckets =
+      (kMaxExponent - kSubBits + 2) * kSubBuckets;
+
+  inline void Record(uint64_t ticks) {
+    std::atomic<uint64_t> &bucket = counts_[Index(ticks)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+    if (ticks > max_.load(std::memory_order_relaxed))
+      max_.store(ticks, std::memory_order_relaxed);
+  }
+
+  void AddTo(uint64_t *counts, uint64_t &max) const {
+    for (size_t i = 0; i < kBuckets; i++)
+      counts[i] += counts_[i].load(std::memory_order_relaxed);
+    uint64_t mine = max_.load(std::memory_order_relaxed);
+    if (mine > max)
+      max = mine;
+  }
+
+  static inline size_t Index(uint64_t value) {
+    if (value < kSubBuckets)
+      return (size_t)value;
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > kMaxExponent)
+      return kBuckets - 1;
+    return (size_t)(exponent - kSubBits + 1) * kSubBuckets +
+           ((value >> (exponent - kSubBits)) & (kSubBuckets - 1));
+  }
+
+  // Highest value of bucket `index`.
+  static uint64_t UpperBound(size_t index) {
+    if (index < kSubBuckets)
+      return index;
+    int exponent = (int)(index / kSubBuckets) + kSubBits - 1;
+    uint64_t width = 1ull << (exponent - kSubBits);
+    return (kSubBuckets + index % kSubBuckets) * width + width - 1;
+  }
+
+private:
+  std::atomic<uint64_t> counts_[kBuckets] = {};
+  std::atomic<uint64_t> max_{0};
+};
+
+// Merged latencies of one op and path, in nanoseconds. A percentile is the
+// highest value of the bucket it falls in, capped by `max`.
+struct LatencyStats {
+  uint64_t count = 0;
+  double p50 = 0;
+  double p99 = 0;
+  double p999 = 0;
+  double max = 0;
+};
+
+// Every thread's histograms of a type merged, see `pool::Latencies<T>()`.
+struct LatencyReport {
+  LatencyStats paths[kLatencyOps][kLatencyPaths];
+  LatencyStats all[kLatencyOps]; // Every path together
+
+  const LatencyStats &Get(LatencyOp op, LatencyPath path) const {
+    return paths[(size_t)op][(size_t)path];
+  }
+  const LatencyStats &Get(LatencyOp op) const { return all[(size_t)op]; }
+
+  // One line per op and path which saw any call.
+  void Write(std::ostream &out, const char *name) const;
+};
+
+// The histograms of one thread, kept after the thread exits and handed to
+// the next thread which starts using the type.
+struct LatencySet {
+  LatencyHistogram histograms[kLatencyOps][kLatencyPaths];
+  LatencySet *next = nullptr;
+
+  inline void Record(LatencyOp op, LatencyPath path, uint64_t ticks) {
+    histograms[(size_t)op][(size_t)path].Record(ticks);
+  }
+};
+
+// Ticks for `LatencySet`, the TSC where there is one. `NsPerTick` scales them
+// with a steady clock pair taken on the first `Now`.
+class LatencyClock {
+public:
+  static inline uint64_t Now() {
+#ifdef LATENCY_HISTOGRAM_HAS_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  // Waits until 10ms passed since the first pair when called before that, a
+  // shorter run would scale with a rough guess.
+  static double NsPerTick();
+
+  // Takes the first pair, `LatencyRegistry::Take` calls it.
+  static void Start() { (void)StartPair(); }
+
+private:
+  struct Pair {
+    uint64_t ticks;
+    std::chrono::steady_clock::time_point time;
+  };
+
+  static const Pair &StartPair() {
+    static const Pair pair{Now(), std::chrono::steady_clock::now()};
+    return pair;
+  }
+};
+
+// The `LatencySet`s of one type.
+class LatencyRegistry {
+public:
+  LatencySet *Take();
+  void Retire(LatencySet *set);
+  LatencyReport Report() const;
+
+private:
+  std::atomic<LatencySet *> sets_{nullptr};
+  std::mutex mutex_;
+  std::vector<LatencySet *> retired_;
+};
+
+inline double LatencyClock::NsPerTick() {
+#ifdef LATENCY_HISTOGRAM_HAS_TSC
+  const Pair &start = StartPair();
+  auto elapsed = std::chrono::steady_clock::now() - start.time;
+  while (elapsed < std::chrono::milliseconds(10))
+    elapsed = std::chrono::steady_clock::now() - start.time;
+  uint64_t ticks = Now() - start.ticks;
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  return ticks > 0 ? ns / (double)ticks : 1.0;
+#else
+  return 1.0;
+#endif
+}
+
+inline LatencySet *LatencyRegistry::Take() {
+  LatencyClock::Start();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!retired_.empty()) {
+      LatencySet *set = retired_.back();
+      retired_.pop_back();
+      return set;
+    }
+  }
+  LatencySet *set = new LatencySet();
+  set->next = sets_.load(std::memory_order_relaxed);
+  while (!sets_.compare_exchange_weak(set->next, set,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed))
+    ;
+  return set;
+}
+
+inline void LatencyRegistry::Retire(LatencySet *set) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  retired_.push_back(set);
+}
+
+inline LatencyReport LatencyRegistry::Report() const {
+  LatencyReport report;
+  double ns_per_tick = LatencyClock::NsPerTick();
+  auto summarize = [ns_per_tick](const std::vector<uint64_t> &counts,
+                                 uint64_t max, LatencyStats &stats) {
+    uint64_t total = 0;
+    for (uint64_t count : counts)
+      total += count;
+    stats.count = total;
+    if (total == 0)
+      return;
+    auto percentile = [&](double q) {
+      // Smallest bucket with at least `q` of the values at or below it.
+      uint64_t rank = (uint64_t)(q * (double)total + 0.999999);
+      rank = rank == 0 ? 1 : rank;
+      uint64_t seen = 0;
+      for (size_t i = 0; i < counts.size(); i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+          uint64_t value = LatencyHistogram::UpperBound(i);
+          return (double)(value < max ? value : max) * ns_per_tick;
+        }
+      }
+      return (double)max * ns_per_tick;
+    };
+    stats.p50 = percentile(0.5);
+    stats.p99 = percentile(0.99);
+    stats.p999 = percentile(0.999);
+    stats.max = (double)max * ns_per_tick;
+  };
+
+  for (size_t op = 0; op < kLatencyOps; op++) {
+    std::vector<uint64_t> all(LatencyHistogram::kBuckets, 0);
+    uint64_t all_max = 0;
+    for (size_t path = 0; path < kLatencyPaths; path++) {
+      std::vector<uint64_t> counts(LatencyHistogram::kBuckets, 0);
+      uint64_t max = 0;
+      for (LatencySet *set = sets_.load(std::memory_order_acquire);
+           set != nullptr; set = set->next)
+        set->histograms[op][path].AddTo(counts.data(), max);
+      summarize(counts, max, report.paths[op][path]);
+      for (size_t i = 0; i < counts.size(); i++)
+        all[i] += counts[i];
+      all_max = max > all_max ? max : all_max;
+    }
+    summarize(all, all_max, report.all[op]);
+  }
+  return report;
+}
+
+inline void LatencyReport::Write(std::ostream &out, const char *name) const {
+  static const char *const kOps[] = {"new", "delete"};
+  static const char *const kPaths[] = {"fast", "drain", "grow", "release"};
+  char line[160];
+  for (size_t op = 0; op < kLatencyOps; op++) {
+    for (size_t path = 0; path <= kLatencyPaths; path++) {
+      const LatencyStats &stats =
+          path < kLatencyPaths ? paths[op][path] : all[op];
+      if (stats.count == 0)
+        continue;
+      snprintf(line, sizeof(line),
+               "%s %-6s %-7s %10llu calls  p50 %8.0f  p99 %8.0f  "
+               "p99.9 %8.0f  max %10.0f ns\n",
+               name, kOps[op], path < kLatencyPaths ? kPaths[path] : "all",
+               (unsigned long long)stats.count, stats.p50, stats.p99,
+               stats.p999, stats.max);
+      out << line;
+    }
+  }
+}
+}; // namespace pool
+
+#endif //__LATENCY_HISTOGRAM_H__
@@ -1,10 +1,22 @@
 #ifndef __MEMORY_POOL_H__
 #define __MEMORY_POOL_H__
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "concurrentqueue.h" // lock-free thread-safe queue
+#include "event_trace.h"
 #include "fixed_pool.h"
+#include "heap_profiler.h"
+#include "latency_histogram.h"
 
 // Notes: We cannot identify if an object has been moved to another thread, well
 // there isn't even any concept of moving objects, we just return the pointer of
@@ -24,48 +36,448 @@
 // bytes unrelated to the specific "object" allocation, just to make it
 // thread-safe, no-loop during allocation/deallocation of an object.
 
+#ifndef MEMORY_POOL_STATS
+#define MEMORY_POOL_STATS 1
+#endif
+
+constexpr bool kPoolStats = MEMORY_POOL_STATS;
+
 template <typename T> class PoolManager;
+template <typename T> class MagazineDepot;
+
+// Chunk knobs of a `Pool<T>`, every new chunk doubles the block count of the
+// previous one until `kMaxBlockCount`, `kStrideMode` tells how the blocks are
+// laid out against cache lines and `kBacking` where the chunks come from.
+// Page backed chunks are filled up to whole pages.
+//
+// Chunks are aligned to the power of two the biggest chunk of their type
+// rounds up to, so the owner lookup stays one mask. An aligned `operator new`
+// of a big alignment is served by its own mmap in glibc even for the small
+// first chunks, so heap backed chunks also stop growing at
+// `kMaxHeapChunkSize` bytes, whichever of the two caps comes first. Page
+// backed chunks are mapped aligned and trimmed, only `kMaxBlockCount` caps
+// them.
+//
+// Every `kReleaseInterval` frees the fully free chunks are checked, a chunk
+// found free by two checks in a row goes back to the system unless it is one
+// of the `kReserveChunks` free chunks kept around so alloc/free cycles at a
+// chunk boundary don't keep creating and releasing it. An interval of 0 never
+// releases. Specialize to tune a type:
+//   template <> struct PoolTraits<MyObj> : DefaultPoolTraits {
+//     static constexpr uint32_t kMaxBlockCount = 1 << 20;
+//     static constexpr ChunkBacking kBacking = ChunkBacking::kMmap;
+//   };
+//
+// `kShareSizeClass` routes the type into the size class pool its size and
+// alignment round up to, so every such type of the same class shares the same
+// chunks instead of owning a `PoolState` per thread. The other knobs are then
+// the size class's ones. Objects of a sharing type which are never deleted
+// don't get their destructor called at exit, and `Clear` isn't available.
+//
+// Deletes of objects owned by another thread are buffered per owner, up to
+// `kRemoteFreeBatch` objects, and pushed to the chunks' thread-free lists one
+// chain per chunk. The buffers are flushed when full, when the deleting
+// thread's own pool runs out of blocks, when it exits or on
+// `pool::FlushRemoteFrees<T>()`. A batch of 0 pushes every delete right away.
+//
+// Chunks the release checks give up are donated to a depot shared by all
+// the threads of a NUMA node, up to `kDepotChunks` chunks, and a thread about
+// to grow adopts one from there before creating a new chunk. So one thread
+// freeing a lot doesn't keep memory another one then has to allocate anew. A
+// depot of 0 chunks disables it.
+//
+// A `kMagazineSize` other than 0 switches the type to magazines instead: every
+// thread caches two magazines of up to `kMagazineSize` free blocks, frees go
+// into the caller's magazines whoever allocated the block, and full or empty
+// magazines are swapped with a global depot. A producer/consumer pair then
+// never sends blocks back, the consumer's full magazines feed the producer.
+// Blocks are carved from chunks which only go back to the system at exit, so
+// objects which are never deleted don't get their destructor called and
+// `Clear` isn't available.
+struct DefaultPoolTraits {
+  static constexpr uint32_t kInitialBlockCount = kDefaultBlockCount;
+  static constexpr uint32_t kMaxBlockCount = kDefaultMaxBlockCount;
+  static constexpr StrideMode kStrideMode = StrideMode::kPacked;
+  static constexpr ChunkBacking kBacking = ChunkBacking::kHeap;
+  static constexpr size_t kMaxHeapChunkSize = kDefaultMaxHeapChunkSize;
+  static constexpr uint32_t kReleaseInterval = kDefaultReleaseInterval;
+  static constexpr uint32_t kReserveChunks = 1;
+  static constexpr bool kShareSizeClass = false;
+  static constexpr uint32_t kRemoteFreeBatch = 32;
+  static constexpr uint32_t kDepotChunks = 16;
+  static constexpr uint32_t kMagazineSize = 0;
+};
+
+template <typename T> struct PoolTraits : DefaultPoolTraits {};
+
+// Owners a thread buffers remote frees for at once, see `kRemoteFreeBatch`.
+constexpr size_t kRemoteFreeSlots = 4;
+
+// Snapshot of a type's counters summed over all of its states, the ones of
+// live threads and the orphaned ones, see `pool::Stats<T>()`. `peak_live`
+// sums the high-water mark of every state, an upper bound of the type's peak.
+// Magazine types count per thread instead of per state and don't track
+// remote deletes or peaks, every delete is local to them.
+struct PoolStats {
+  uint64_t news = 0;
+  uint64_t deletes = 0;         // Of objects owned by the deleting thread
+  uint64_t remote_sent = 0;     // Deletes of objects other threads own
+  uint64_t remote_received = 0; // Deletes other threads handed over
+  uint64_t drains = 0;          // Collects which found remote deletes
+  uint64_t new_chunks = 0;      // `AddNewPool` calls
+  uint64_t live = 0;            // Blocks in use
+  uint64_t peak_live = 0;
+  uint64_t chunks = 0;
+  size_t states = 0;
+};
+
+// Counters of one `PoolState`, or of one thread in magazine mode. Only the
+// thread working on it writes them, with a relaxed load and store rather
+// than a read-modify-write, which compiles to a plain increment of a line the
+// writer already owns. Any thread can read them for `pool::Stats<T>()`.
+// `MEMORY_POOL_STATS=0` compiles the updates out.
+struct PoolCounters {
+  using Counter = std::atomic<uint64_t>;
+
+  Counter news{0};
+  Counter deletes{0};
+  Counter remote_sent{0};
+  Counter remote_received{0};
+  Counter drains{0};
+  Counter new_chunks{0};
+  Counter live{0};
+  Counter peak_live{0};
+  Counter chunks{0};
+
+  static inline void Add(Counter &counter, uint64_t n) {
+    if constexpr (kPoolStats)
+      counter.store(counter.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+  }
+
+  static inline void Set(Counter &counter, uint64_t value) {
+    if constexpr (kPoolStats)
+      counter.store(value, std::memory_order_relaxed);
+  }
+
+  inline void CountNews(uint64_t n) {
+    if constexpr (kPoolStats) {
+      Add(news, n);
+      Add(live, n);
+      uint64_t now = live.load(std::memory_order_relaxed);
+      if (now > peak_live.load(std::memory_order_relaxed))
+        Set(peak_live, now);
+    }
+  }
+
+  inline void CountDeletes(uint64_t n) {
+    Add(deletes, n);
+    Add(live, -n);
+  }
+
+  inline void CountReceived(uint64_t n) {
+    Add(remote_received, n);
+    Add(live, -n);
+    Add(drains, 1);
+  }
+
+  void AddTo(PoolStats &stats) const {
+    stats.news += news.load(std::memory_order_relaxed);
+    stats.deletes += deletes.load(std::memory_order_relaxed);
+    stats.remote_sent += remote_sent.load(std::memory_order_relaxed);
+    stats.remote_received += remote_received.load(std::memory_order_relaxed);
+    stats.drains += drains.load(std::memory_order_relaxed);
+    stats.new_chunks += new_chunks.load(std::memory_order_relaxed);
+    stats.live += live.load(std::memory_order_relaxed);
+    stats.peak_live += peak_live.load(std::memory_order_relaxed);
+    stats.chunks += chunks.load(std::memory_order_relaxed);
+  }
+};
+
+// Block sizes of the type-erased pools behind `pool::Allocate`, a class is
+// aligned to the biggest power of two dividing its size, up to a cache line.
+// Every class uses chunks of at most `kChunkSize` bytes, so all of them share
+// the same chunk alignment and `pool::Free` finds the class of any block by
+// masking its address.
+struct SizeClasses {
+  static constexpr size_t kSizes[] = {8,   16,  24,  32,  48,  64,  80,  96,
+                                      112, 128, 160, 192, 224, 256, 320, 384,
+                                      448, 512, 640, 768, 896, 1024};
+  static constexpr size_t kCount = std::size(kSizes);
+  static constexpr size_t kMaxSize = kSizes[kCount - 1];
+  static constexpr size_t kChunkSize = 64 * 1024;
+  // Upper bound of a `Pool<T>` chunk's metadata.
+  static constexpr size_t kMaxMetaSize = 128;
+
+  static constexpr size_t Alignment(size_t size) {
+    size_t r = size & (~size + 1);
+    return r < kCacheLineSize ? r : kCacheLineSize;
+  }
+
+  // Smallest class fitting `size` bytes aligned to `alignment`, `kCount` if
+  // there is none.
+  static constexpr size_t Index(size_t size, size_t alignment) {
+    size_t i = 0;
+    while (i < kCount &&
+           (kSizes[i] < size || Alignment(kSizes[i]) < alignment))
+      i++;
+    return i;
+  }
+
+  // Block size of the class `Index` picks, 0 if there is none.
+  static constexpr size_t SizeFor(size_t size, size_t alignment) {
+    size_t i = Index(size, alignment);
+    return i < kCount ? kSizes[i] : 0;
+  }
+
+  // Same as `Index` but a table lookup, since every class is a multiple of 8
+  // the class of `size` only depends on `(size + 7) / 8`.
+  static inline size_t Lookup(size_t size, size_t alignment);
+};
+
+inline constexpr std::array<uint8_t, SizeClasses::kMaxSize / 8 + 1>
+    kSizeClassLookup = [] {
+      std::array<uint8_t, SizeClasses::kMaxSize / 8 + 1> r{};
+      for (size_t i = 0; i < r.size(); i++)
+        r[i] = (uint8_t)SizeClasses::Index(i * 8, 1);
+      return r;
+    }();
+
+inline size_t SizeClasses::Lookup(size_t size, size_t alignment) {
+  size_t i = kSizeClassLookup[(size + 7) / 8];
+  while (Alignment(kSizes[i]) < alignment)
+    i++;
+  return i;
+}
+
+// Storage of one block of a size class, the default constructor leaves it
+// uninitialized.
+template <size_t Size> struct SizeClassBlock {
+  SizeClassBlock() {}
+  alignas(SizeClasses::Alignment(Size)) unsigned char bytes[Size];
+};
+
+template <typename T> constexpr bool kIsSizeClassBlock = false;
+template <size_t Size>
+constexpr bool kIsSizeClassBlock<SizeClassBlock<Size>> = true;
+
+template <size_t Size>
+struct PoolTraits<SizeClassBlock<Size>> : DefaultPoolTraits {
+  static constexpr uint32_t kMaxBlockCount = FixedPool::BlocksFitting(
+      SizeClasses::kChunkSize, SizeClasses::kMaxMetaSize, Size,
+      SizeClasses::Alignment(Size));
+  static constexpr uint32_t kInitialBlockCount =
+      kDefaultBlockCount < kMaxBlockCount ? kDefaultBlockCount
+                                          : kMaxBlockCount;
+};
 
 template <typename T> class Pool {
 private:
   friend class PoolManager<T>;
+  friend class MagazineDepot<T>;
+  using Traits = PoolTraits<T>;
+
+  static_assert(Traits::kInitialBlockCount > 0 &&
+                    Traits::kInitialBlockCount <= Traits::kMaxBlockCount,
+                "Initial block count must be in (0, kMaxBlockCount].");
+
+  // Chunk metadata, lives at the base of the chunk right before the blocks,
+  // so the chunk, the `FixedPool` and the blocks are one allocation.
   struct InnerFixedPool {
-    size_t id;
-    size_t next_id;
+    FixedPool pool_instance;
+    InnerFixedPool *next_chunk; // Every chunk of the owner
+    InnerFixedPool *next_free;  // Chunks with free block(s)
+    // Chunks with blocks on their thread-free list, see `pending_chunks`.
+    InnerFixedPool *next_pending;
     uintptr_t owner_identifier;
-    FixedPool *pool_instance;
+    uint32_t idle_checks; // Release checks in a row which found it unused
+    // One bit per block `pool::HeapProfiler` sampled, allocated with the
+    // chunk's first sample and kept until the chunk is destroyed, deleters on
+    // other threads may still load it. The owner sets the bits, any deleter
+    // clears them.
+    std::atomic<std::atomic<uint64_t> *> sampled_blocks;
+
+    InnerFixedPool(uintptr_t t_owner_identifier, uint32_t blocks)
+        : pool_instance((uintptr_t)this,
+                        FixedPool::BlocksStart(this, sizeof(InnerFixedPool),
+                                               kBlockAlignment),
+                        kBlockStride, blocks),
+          next_chunk(nullptr), next_free(nullptr), next_pending(nullptr),
+          owner_identifier(t_owner_identifier), idle_checks(0),
+          sampled_blocks(nullptr) {}
+
+    static constexpr size_t ChunkSize(uint32_t blocks) {
+      return FixedPool::ChunkSize(sizeof(InnerFixedPool), kBlockStride, blocks,
+                                  kBlockAlignment);
+    }
+
+    // Grows `blocks` so the chunk ends exactly at a backing page boundary.
+    static constexpr uint32_t FillPages(uint32_t blocks) {
+      size_t chunk_size = FixedPool::Align(
+          ChunkSize(blocks), FixedPool::BackingPageSize(Traits::kBacking));
+      return FixedPool::BlocksFitting(chunk_size, sizeof(InnerFixedPool),
+                                      kBlockStride, kBlockAlignment);
+    }
+
+    static InnerFixedPool *Create(uintptr_t t_owner_identifier,
+                                  uint32_t blocks, int numa_node) {
+      void *chunk = FixedPool::AllocateChunk(
+          ChunkSize(blocks), kChunkAlignment, Traits::kBacking, numa_node);
+      return new (chunk) InnerFixedPool(t_owner_identifier, blocks);
+    }
+
+    static void Destroy(InnerFixedPool *inner_pool) {
+      size_t chunk_size = ChunkSize(inner_pool->pool_instance.GetNumOfBlocks());
+      delete[] inner_pool->sampled_blocks.load(std::memory_order_relaxed);
+      inner_pool->~InnerFixedPool();
+      FixedPool::FreeChunk(inner_pool, chunk_size, kChunkAlignment,
+                           Traits::kBacking);
+    }
 
-    InnerFixedPool(size_t t_id, size_t t_next_id, uintptr_t t_owner_identifier,
-                   size_t blocks)
-        : id(t_id), next_id(t_next_id), owner_identifier(t_owner_identifier),
-          pool_instance(FixedPool::Create((uintptr_t)this, sizeof(T), blocks)) {
+    // Owner chunk of an object, just masks the object's address.
+    static inline InnerFixedPool *FromData(T *instance) {
+      return (InnerFixedPool *)FixedPool::ChunkFromAddr(instance,
+                                                        kChunkAlignment);
     }
-    ~InnerFixedPool() { delete pool_instance; }
+  };
+
+  static constexpr size_t kBlockAlignment =
+      FixedPool::BlockAlignment(alignof(T), Traits::kStrideMode);
+  static constexpr size_t kBlockStride =
+      FixedPool::BlockStride(sizeof(T), alignof(T), Traits::kStrideMode);
+
+  // Blocks of the biggest chunk, heap backed chunks are capped at
+  // `kMaxHeapChunkSize` bytes too(but hold at least one block).
+  static constexpr uint32_t kMaxBlocks = [] {
+    if constexpr (Traits::kBacking != ChunkBacking::kHeap)
+      return Traits::kMaxBlockCount;
+    uint32_t fitting = FixedPool::BlocksFitting(
+        Traits::kMaxHeapChunkSize, sizeof(InnerFixedPool), kBlockStride,
+        kBlockAlignment);
+    fitting = fitting == 0 ? 1 : fitting;
+    return Traits::kMaxBlockCount < fitting ? Traits::kMaxBlockCount
+                                            : fitting;
+  }();
+  static constexpr uint32_t kInitialBlocks =
+      Traits::kInitialBlockCount < kMaxBlocks ? Traits::kInitialBlockCount
+                                              : kMaxBlocks;
+
+  // Every chunk is aligned to the size of the biggest chunk, so masking works
+  // no matter which growth step created the chunk.
+  static constexpr size_t kChunkAlignment = FixedPool::NextPowerOfTwo(
+      InnerFixedPool::ChunkSize(InnerFixedPool::FillPages(kMaxBlocks)));
+
+  static_assert(!kIsSizeClassBlock<T> ||
+                    (sizeof(InnerFixedPool) <= SizeClasses::kMaxMetaSize &&
+                     kChunkAlignment == SizeClasses::kChunkSize),
+                "Every size class must share the same chunk alignment.");
+
+  // Pool of the size class the type is routed into, see `kShareSizeClass`.
+  static constexpr bool kShared = Traits::kShareSizeClass;
+  using SharedBlock =
+      SizeClassBlock<SizeClasses::SizeFor(sizeof(T), alignof(T))>;
+  using SharedPool = Pool<SharedBlock>;
+
+  static_assert(!kShared || SizeClasses::SizeFor(sizeof(T), alignof(T)) != 0,
+                "No size class fits the type.");
+
+  // See `kMagazineSize`.
+  static constexpr bool kMagazines = Traits::kMagazineSize != 0;
+
+  static_assert(!kMagazines || !kShared,
+                "Size class pools don't use magazines.");
+
+  struct Magazine {
+    uint32_t count = 0;
+    T *blocks[kMagazines ? Traits::kMagazineSize : 1];
+
+    bool IsFull() const { return count == Traits::kMagazineSize; }
+  };
+
+  // The calling thread's magazines, Bonwick style: `previous` is always full
+  // or empty, so one swap with `loaded` serves a whole magazine of frees or
+  // allocations without going to the depot.
+  struct MagazineCache {
+    Magazine *loaded = nullptr;
+    Magazine *previous = nullptr;
+    // Chunk being carved when the depot has no full magazine.
+    uintptr_t carve = 0;
+    uintptr_t carve_end = 0;
+    uint32_t next_block_count = kInitialBlocks;
+    std::optional<moodycamel::ProducerToken> full_token;
+    std::optional<moodycamel::ProducerToken> empty_token;
+    PoolCounters *counters = nullptr; // Registered in the `MagazineDepot`
+  };
+  struct NoMagazines {};
+
+  // Who is working on a `PoolState`, only one thread at a time does.
+  enum StateStatus : uint32_t {
+    kOwned,      // A live thread's `Pool<T>`
+    kOrphaned,   // Parked in the `PoolManager`, nobody working on it
+    kReclaiming, // A thread which freed into it is collecting its frees
   };
 
   // Represents the `Pool<T>`'s moveable state.
   struct PoolState {
-    // Lock-free thread-safe queue
-    moodycamel::ConcurrentQueue<T *> dealloc_req_queue;
-    moodycamel::ConsumerToken consumer_token;
-
     InnerFixedPool *next_pool;
-    std::vector<InnerFixedPool *> pools;
+    InnerFixedPool *chunks;
+    size_t num_chunks;
     size_t num_free_pools;
+    uint32_t next_block_count;
+    size_t release_countdown;
+    int numa_node; // Node of the thread which created the state
+    // Of the depot queue of `numa_node`, made on the first donation and used
+    // by whichever thread works on the state.
+    std::optional<moodycamel::ProducerToken> depot_token;
+    PoolCounters counters;
+    PoolState *next_state; // Every state ever created, see `PoolManager`
+
+    // The only fields other threads write, on a line of their own so the
+    // owner's allocations and counters never share it.
+    //
+    // Chunks other threads freed blocks into, a chunk is pushed by whoever
+    // finds its thread-free list empty and stays here until the owner
+    // collects it, so it is never on the list twice.
+    alignas(kCacheLineSize) std::atomic<InnerFixedPool *> pending_chunks;
+    std::atomic<uint32_t> status;
 
     PoolState()
-        : consumer_token(dealloc_req_queue),
-          next_pool(
-              new InnerFixedPool(0, 1, (uintptr_t)this, kDefaultBlockCount)),
-          pools({next_pool}), num_free_pools(1) {}
+        : next_pool(nullptr), chunks(nullptr), num_chunks(0),
+          num_free_pools(0), next_block_count(kInitialBlocks),
+          release_countdown(Traits::kReleaseInterval),
+          numa_node(NumaTopology::CurrentNode()), next_state(nullptr),
+          pending_chunks(nullptr), status(kOwned) {
+      AddNewPool();
+    }
 
+    // New chunks go to the node of the owner thread, which is the caller.
+    // A chunk another thread donated is adopted first, see `kDepotChunks`.
     inline InnerFixedPool *AddNewPool() {
-      size_t pool_id = pools.size();
-
-      InnerFixedPool *inner_pool = new InnerFixedPool(
-          pool_id, pool_id + 1, (uintptr_t)this, kDefaultBlockCount);
-      pools.push_back(inner_pool);
+      InnerFixedPool *inner_pool = PoolManager<T>::Instance().TakeChunk();
+      if (inner_pool != nullptr) {
+        // Fully free, no other thread can reach it through a block. Rewound
+        // so the blocks go out in address order, not in the order the donor
+        // freed them.
+        inner_pool->owner_identifier = (uintptr_t)this;
+        inner_pool->idle_checks = 0;
+        inner_pool->pool_instance.ReclaimAll();
+      } else {
+        uint32_t blocks = InnerFixedPool::FillPages(next_block_count);
+        inner_pool = InnerFixedPool::Create((uintptr_t)this, blocks,
+                                            NumaTopology::CurrentNode());
+        next_block_count =
+            blocks > kMaxBlocks / 2 ? kMaxBlocks : blocks * 2;
+      }
+      inner_pool->next_chunk = chunks;
+      chunks = inner_pool;
+      num_chunks++;
+      PoolCounters::Add(counters.new_chunks, 1);
+      Trace(pool::TraceKind::kNewChunk,
+            (void *)(uintptr_t)inner_pool->pool_instance.GetNumOfBlocks(),
+            inner_pool);
+      PoolCounters::Set(counters.chunks, num_chunks);
 
+      inner_pool->next_free = next_pool;
       next_pool = inner_pool;
       num_free_pools++;
 
@@ -73,20 +485,187 @@ private:
     }
 
     // Must be called before `FixedPool::ForcedDeAllocate` gets called. Since
-    // we're kind of checking if it is already in the "free pools" list.
+    // we're kind of checking if it is already in the "free pools" list. The
+    // active pool is always on top of the list even when it is full.
     inline void SetNextFreePool(InnerFixedPool *pool) {
-      if (pool->pool_instance->IsAnyBlockAvailable())
+      // Just got used, not idle anymore.
+      pool->idle_checks = 0;
+      if (pool == next_pool || pool->pool_instance.IsAnyBlockAvailable())
         return;
-      num_free_pools++;
-      pool->next_id = next_pool->id;
+      // A full active pool takes the place of nothing, the freed pool replaces
+      // it so no full pool ever sits below the top of the list.
+      if (next_pool->pool_instance.IsAnyBlockAvailable()) {
+        num_free_pools++;
+        pool->next_free = next_pool;
+      } else {
+        pool->next_free = next_pool->next_free;
+      }
       next_pool = pool;
     }
 
-    inline void AddDeallocRequest(T *data) { dealloc_req_queue.enqueue(data); }
+    // Pushes the chain of blocks `first`...`last`, all from `chunk`, from any
+    // thread.
+    static inline void AddThreadFree(InnerFixedPool *chunk, T *first,
+                                     T *last) {
+      FixedPool *pool = &chunk->pool_instance;
+      if (!pool->PushThreadFree<kBlockStride>(first, last))
+        return;
+      PoolState *owner = (PoolState *)chunk->owner_identifier;
+      InnerFixedPool *head = owner->pending_chunks.load(
+          std::memory_order_relaxed);
+      do {
+        chunk->next_pending = head;
+      } while (!owner->pending_chunks.compare_exchange_weak(head, chunk));
+
+      // Nobody would collect it until some thread adopts the state, which
+      // might never happen.
+      if (owner->status.load() == kOrphaned)
+        owner->ReclaimOrphan();
+    }
+
+    // Parks the state, what is left of the owner's frees is collected and
+    // the fully free chunks are released.
+    void Orphan() {
+      CollectThreadFrees();
+      ReleaseEmptyChunks(true);
+      status.store(kOrphaned);
+      // Frees pushed while the state was still owned.
+      if (pending_chunks.load() != nullptr)
+        ReclaimOrphan();
+    }
+
+    // Runs on a thread which freed into the orphaned state, it takes the
+    // state over while collecting unless an adopter or another reclaimer
+    // already holds it.
+    //
+    // Both sides store then load, sequentially consistent, so either the
+    // pusher sees `kOrphaned` or the reclaimer sees the pushed chunk.
+    void ReclaimOrphan() {
+      uint32_t expected = kOrphaned;
+      while (status.compare_exchange_strong(expected, kReclaiming)) {
+        CollectThreadFrees();
+        ReleaseEmptyChunks(true);
+        status.store(kOrphaned);
+        if (pending_chunks.load() == nullptr)
+          return;
+        expected = kOrphaned;
+      }
+    }
+
+    // Makes the calling thread the owner, waits out a running reclaim.
+    void Adopt() {
+      uint32_t expected = kOrphaned;
+      while (!status.compare_exchange_weak(expected, kOwned)) {
+        expected = kOrphaned;
+        std::this_thread::yield();
+      }
+    }
+
+    // Owner only, frees everything other threads handed over and returns how
+    // many blocks got freed.
+    inline size_t CollectThreadFrees() {
+      size_t total = 0;
+      InnerFixedPool *chunk =
+          pending_chunks.exchange(nullptr, std::memory_order_acquire);
+      while (chunk != nullptr) {
+        // Read before the collect, a pusher may reuse the link right after.
+        InnerFixedPool *next = chunk->next_pending;
+        SetNextFreePool(chunk);
+        FixedPool *pool = &chunk->pool_instance;
+        total += pool->CollectThreadFree<kBlockStride>();
+        chunk = next;
+      }
+      if (total > 0)
+        counters.CountReceived(total);
+      return total;
+    }
+
+    // Counts `n` frees towards the next release check, returns whether the
+    // check ran.
+    inline bool CountFrees(size_t n) {
+      if constexpr (Traits::kReleaseInterval != 0) {
+        if (release_countdown > n) {
+          release_countdown -= n;
+          return false;
+        }
+        ReleaseEmptyChunks();
+        return true;
+      }
+      return false;
+    }
+
+    // Releases the chunks found unused by two checks in a row beyond the
+    // reserve, then rebuilds the "free pools" list from what is left. The
+    // active pool is never released and stays on top of the list. An
+    // orphaned state has nobody cycling through its chunks, every unused one
+    // but the active pool goes right away.
+    //
+    // A released chunk is donated to the depot while the depot has room,
+    // only the rest goes back to the system.
+    void ReleaseEmptyChunks(bool orphaned = false) {
+      release_countdown = Traits::kReleaseInterval;
+
+      uint32_t reserve = orphaned ? 0 : Traits::kReserveChunks;
+      InnerFixedPool *free_pools = nullptr;
+      size_t free_pools_count = 0;
+      InnerFixedPool **link = &chunks;
+      while (*link != nullptr) {
+        InnerFixedPool *chunk = *link;
+        if (chunk != next_pool && !chunk->pool_instance.IsAnyBlockUsed()) {
+          if (reserve > 0) {
+            reserve--;
+          } else if (orphaned || chunk->idle_checks++ > 0) {
+            *link = chunk->next_chunk;
+            num_chunks--;
+            if (!PoolManager<T>::Instance().DonateChunk(chunk, numa_node,
+                                                        depot_token))
+              InnerFixedPool::Destroy(chunk);
+            continue;
+          }
+        } else {
+          chunk->idle_checks = 0;
+        }
+
+        if (chunk != next_pool && chunk->pool_instance.IsAnyBlockAvailable()) {
+          chunk->next_free = free_pools;
+          free_pools = chunk;
+          free_pools_count++;
+        }
+        link = &chunk->next_chunk;
+      }
+
+      next_pool->next_free = free_pools;
+      num_free_pools = free_pools_count + 1;
+      PoolCounters::Set(counters.chunks, num_chunks);
+    }
+  };
+
+  // Remote frees buffered for one owner.
+  struct RemoteFreeSlot {
+    PoolState *owner = nullptr;
+    uint32_t count = 0;
+    T *items[Traits::kRemoteFreeBatch > 0 ? Traits::kRemoteFreeBatch : 1];
+
+    void Flush() {
+      PushRemoteFrees(items, count);
+      count = 0;
+    }
+  };
+
+  struct RemoteFrees {
+    RemoteFreeSlot slots[kRemoteFreeSlots];
+    uint32_t next_evict = 0;
   };
 
 private:
   PoolState *state_ = nullptr;
+  // Only allocated once this thread deletes an object owned by another one.
+  std::unique_ptr<RemoteFrees> remote_frees_;
+  [[no_unique_address]] std::conditional_t<kMagazines, MagazineCache,
+                                           NoMagazines> magazines_;
+  // See `MEMORY_POOL_LATENCY`, the path of the call being timed.
+  pool::LatencySet *latency_ = nullptr;
+  pool::LatencyPath latency_path_ = pool::LatencyPath::kFast;
 
 public:
   // `thread_local`'s language implementation guarantees that the destructor
@@ -109,73 +688,458 @@ public:
   // The object's life time if not deleted by calling `Pool<T>::Delete` is until
   // the main process/thread exits.
   template <typename... Args> T *New(Args &&...args) {
+    if constexpr (kShared) {
+      void *space = SharedPool::Instance().New();
+      return new (space) T(std::forward<Args>(args)...);
+    }
+    uint64_t start = StartLatency();
+    if constexpr (kMagazines) {
+      PoolCounters::Add(magazines_.counters->news, 1);
+      void *space = MagazineAllocate();
+      Trace(pool::TraceKind::kNew, space, nullptr);
+      EndLatency(pool::LatencyOp::kNew, start);
+      return new (space) T(std::forward<Args>(args)...);
+    }
     FixedPool *pool = GetActiveFixedPool();
 
-    void *space = pool->ForcedAllocate();
+    void *space = pool->ForcedAllocate<kBlockStride>();
+    state_->counters.CountNews(1);
+    if (pool::HeapProfiler::ShouldSample(kBlockStride)) [[unlikely]]
+      SampleBlock(space);
+    Trace(pool::TraceKind::kNew, space, pool);
+    EndLatency(pool::LatencyOp::kNew, start);
     return new (space) T(std::forward<Args>(args)...);
   }
 
+  // Creates `out.size()` T objects, every one initialized with the same
+  // constructor arguments. Takes whole runs of blocks from a pool at once and
+  // moves on to the next pool(or grows) when one runs out.
+  template <typename... Args>
+  void NewBatch(std::span<T *> out, const Args &...args) {
+    if constexpr (kShared) {
+      SharedPool::Instance().NewBatch(
+          std::span<SharedBlock *>((SharedBlock **)out.data(), out.size()));
+    } else if constexpr (kMagazines) {
+      for (T *&space : out) {
+        space = (T *)MagazineAllocate();
+        Trace(pool::TraceKind::kNew, space, nullptr);
+      }
+      PoolCounters::Add(magazines_.counters->news, out.size());
+    } else {
+      size_t done = 0;
+      while (done < out.size()) {
+        FixedPool *pool = GetActiveFixedPool();
+        size_t left = out.size() - done;
+        uint32_t n = left > UINT32_MAX ? UINT32_MAX : (uint32_t)left;
+        done += pool->AllocateBatch<kBlockStride>(n, out.data() + done);
+      }
+      state_->counters.CountNews(out.size());
+      for (T *space : out) {
+        if (pool::HeapProfiler::ShouldSample(kBlockStride)) [[unlikely]]
+          SampleBlock(space);
+        Trace(pool::TraceKind::kNew, space, InnerFixedPool::FromData(space));
+      }
+    }
+
+    for (T *&space : out)
+      space = new ((void *)space) T(args...);
+  }
+
   // Tries to dealloc the given instance and always calls the destructor.
   //
   // Safety: The object `instance` must've been created using the
   // `Pool::New` function.
   void Delete(T *instance) {
-    InnerFixedPool *inner_pool =
-        (InnerFixedPool *)FixedPool::ReadHeader((void *)instance)
-            ->pool_identifier;
+    if constexpr (kShared) {
+      instance->~T();
+      SharedPool::Instance().Delete((SharedBlock *)instance);
+      return;
+    }
+    if constexpr (kMagazines) {
+      instance->~T();
+      uint64_t start = StartLatency();
+      MagazineFree(instance);
+      PoolCounters::Add(magazines_.counters->deletes, 1);
+      Trace(pool::TraceKind::kDelete, instance, nullptr);
+      EndLatency(pool::LatencyOp::kDelete, start);
+      return;
+    }
+    InnerFixedPool *inner_pool = InnerFixedPool::FromData(instance);
+    ForgetSample(inner_pool, instance);
     PoolState *pool_owner_state = (PoolState *)inner_pool->owner_identifier;
+    // Calling the destructor before actually deallocating the reserved
+    // memory. So the current thread can act as if the object has been freed,
+    // and the deletes it makes itself aren't timed as part of this one.
+    instance->~T();
+    uint64_t start = StartLatency();
     // We're stating our intention that we're basically checking if a *moved*
     // object to a different thread has requested to deallocate some space.
     // We assume that object has been *moved* to current thread. And the thread
     // who created this object doesn't own it anymore.
     if (state_ != pool_owner_state) {
-      // Calling the destructor before actually deallocating the reserved
-      // memory. So the current thread can act as if the object has been freed.
-      instance->~T();
-      pool_owner_state->AddDeallocRequest(instance);
+      AddRemoteFree(pool_owner_state, instance);
+      PoolCounters::Add(state_->counters.remote_sent, 1);
+      Trace(pool::TraceKind::kDelete, instance, inner_pool, pool::kTraceRemote);
+      EndLatency(pool::LatencyOp::kDelete, start);
       return;
     }
     state_->SetNextFreePool(inner_pool);
 
-    instance->~T();
-    inner_pool->pool_instance->ForcedDeAllocate((void *)instance);
+    FixedPool *pool = &inner_pool->pool_instance;
+    pool->ForcedDeAllocate<kBlockStride>((void *)instance);
+    state_->counters.CountDeletes(1);
+    if (state_->CountFrees(1))
+      MarkLatency(pool::LatencyPath::kRelease);
+    Trace(pool::TraceKind::kDelete, instance, inner_pool);
+    EndLatency(pool::LatencyOp::kDelete, start);
+  }
+
+  // Same as calling `Delete` for every instance, but the instances owned by
+  // other threads are handed over one chain per chunk.
+  //
+  // Note: Reorders `instances`, the ones owned by other threads end up at the
+  // front sorted by address.
+  void DeleteBatch(std::span<T *> instances) {
+    if constexpr (kShared) {
+      for (T *instance : instances)
+        instance->~T();
+      SharedPool::Instance().DeleteBatch(std::span<SharedBlock *>(
+          (SharedBlock **)instances.data(), instances.size()));
+      return;
+    }
+    if constexpr (kMagazines) {
+      for (T *instance : instances)
+        Delete(instance);
+      return;
+    }
+    size_t remote = 0;
+    size_t local = 0;
+    for (T *instance : instances) {
+      InnerFixedPool *inner_pool = InnerFixedPool::FromData(instance);
+      ForgetSample(inner_pool, instance);
+      instance->~T();
+      if (state_ != (PoolState *)inner_pool->owner_identifier) {
+        Trace(pool::TraceKind::kDelete, instance, inner_pool,
+              pool::kTraceRemote);
+        instances[remote++] = instance;
+        continue;
+      }
+      Trace(pool::TraceKind::kDelete, instance, inner_pool);
+      state_->SetNextFreePool(inner_pool);
+      FixedPool *pool = &inner_pool->pool_instance;
+      pool->ForcedDeAllocate<kBlockStride>((void *)instance);
+      local++;
+    }
+    if (local > 0) {
+      state_->counters.CountDeletes(local);
+      state_->CountFrees(local);
+    }
+    PoolCounters::Add(state_->counters.remote_sent, remote);
+
+    // Chunks are aligned address ranges, sorting puts the blocks of every
+    // chunk next to each other so each chunk gets a single push.
+    std::sort(instances.begin(), instances.begin() + remote);
+    PushRemoteFrees(instances.data(), remote);
   }
 
   // Reclaims all the allocated space for reuse.
   // Calls all the allocated object's destructor.
-  void Clear() {
-    std::vector<InnerFixedPool *> &pools = state_->pools;
-
+  //
+  // Objects other threads deleted are collected first, but only the ones
+  // they already handed over. Every other thread which deleted objects of
+  // this one must have flushed them(`pool::FlushRemoteFrees<T>()`) or exited
+  // before, and must not delete any while `Clear` runs, a delete still
+  // buffered would destroy and free its block a second time.
+  //
+  // Destructors may `Delete` other objects of the pool, e.g. the children a
+  // node owns, as long as no object is deleted after `Clear` destroyed it.
+  // The chunks are walked oldest first and the cleared pool hands them out
+  // in that order again, so objects created after their owner are reached
+  // through it. No chunk is released before `Clear` returns.
+  void Clear()
+    requires(!kShared && !kMagazines)
+  {
     ConsumeDeallocRequests();
-    for (size_t i = 0, n = pools.size(); i < n; i++) {
-      auto &pool = pools[i];
+    std::vector<InnerFixedPool *> chunks;
+    chunks.reserve(state_->num_chunks);
+    for (InnerFixedPool *pool = state_->chunks; pool; pool = pool->next_chunk)
+      chunks.push_back(pool);
+    std::reverse(chunks.begin(), chunks.end());
+    state_->release_countdown = SIZE_MAX;
+    for (InnerFixedPool *pool : chunks)
+      DeleteObjectsFromPool(pool);
+    state_->release_countdown = Traits::kReleaseInterval;
 
-      pool->id = i;
-      pool->next_id = i + 1;
+    InnerFixedPool *free_pools = nullptr;
+    InnerFixedPool **free_link = &free_pools;
+    size_t free_pools_count = 0;
+    uint64_t used = 0;
+    for (InnerFixedPool *pool : chunks) {
+      FixedPool *fixed_pool = &pool->pool_instance;
+      used += fixed_pool->GetNumOfBlocks() - fixed_pool->GetNumOfFreeBlocks();
+      if (pool != chunks.front() && fixed_pool->IsAnyBlockAvailable()) {
+        *free_link = pool;
+        free_link = &pool->next_free;
+        free_pools_count++;
+      }
+    }
+    *free_link = nullptr;
+    state_->next_pool = chunks.front();
+    state_->next_pool->next_free = free_pools;
+    state_->num_free_pools = free_pools_count + 1;
+    PoolCounters::Set(state_->counters.live, used);
+  }
 
-      DeleteObjectsFromPool(pool->pool_instance);
+  // Hands the buffered deletes of objects owned by other threads over to
+  // their owners.
+  void FlushRemoteFrees() {
+    if constexpr (kShared) {
+      SharedPool::Instance().FlushRemoteFrees();
+      return;
     }
+    if (!remote_frees_)
+      return;
+    for (RemoteFreeSlot &slot : remote_frees_->slots)
+      slot.Flush();
+  }
+
+  size_t GetNumOfChunks() const {
+    if constexpr (kShared)
+      return SharedPool::Instance().GetNumOfChunks();
+    if constexpr (kMagazines)
+      return MagazineDepot<T>::Instance().GetNumOfChunks();
+    return state_->num_chunks;
   }
 
+  // Counters summed over every thread which used the type, see `PoolStats`.
+  // Types sharing a size class report the whole class.
+  static PoolStats Stats();
+
+  // New/Delete latencies merged over every thread which used the type, by
+  // path, only filled with `MEMORY_POOL_LATENCY=1`. Types sharing a size class
+  // report the whole class. Object constructors and destructors aren't timed.
+  static pool::LatencyReport Latencies();
+
 private:
+  inline void *MagazineAllocate() {
+    Magazine *loaded = magazines_.loaded;
+    if (loaded->count > 0) [[likely]]
+      return loaded->blocks[--loaded->count];
+    return MagazineAllocateSlow();
+  }
+
+  inline void MagazineFree(T *instance) {
+    Magazine *loaded = magazines_.loaded;
+    if (!loaded->IsFull()) [[likely]] {
+      loaded->blocks[loaded->count++] = instance;
+      return;
+    }
+    MagazineFreeSlow(instance);
+  }
+
+  // `loaded` is empty.
+  void *MagazineAllocateSlow() {
+    MarkLatency(pool::LatencyPath::kDrain);
+    MagazineCache &cache = magazines_;
+    if (cache.previous->count == 0) {
+      Magazine *full = MagazineDepot<T>::Instance().TakeFull();
+      if (full == nullptr)
+        return CarveBlock();
+      MagazineDepot<T>::Instance().PutEmpty(cache.previous, cache.empty_token);
+      cache.previous = full;
+    }
+    std::swap(cache.loaded, cache.previous);
+    return cache.loaded->blocks[--cache.loaded->count];
+  }
+
+  // `loaded` is full.
+  void MagazineFreeSlow(T *instance) {
+    MarkLatency(pool::LatencyPath::kDrain);
+    MagazineCache &cache = magazines_;
+    if (cache.previous->count != 0) {
+      MagazineDepot<T>::Instance().PutFull(cache.previous, cache.full_token);
+      cache.previous = MagazineDepot<T>::Instance().TakeEmpty();
+    }
+    std::swap(cache.loaded, cache.previous);
+    cache.loaded->blocks[cache.loaded->count++] = instance;
+  }
+
+  void *CarveBlock() {
+    MagazineCache &cache = magazines_;
+    if (cache.carve == cache.carve_end) {
+      MarkLatency(pool::LatencyPath::kGrow);
+      uint32_t blocks = cache.next_block_count;
+      cache.carve = MagazineDepot<T>::Instance().NewChunk(blocks);
+      cache.carve_end = cache.carve + blocks * kBlockStride;
+      cache.next_block_count =
+          blocks > kMaxBlocks / 2 ? kMaxBlocks : blocks * 2;
+    }
+    void *block = (void *)cache.carve;
+    cache.carve += kBlockStride;
+    return block;
+  }
+
+  // Id of the type in `pool::EventTrace` files.
+  static uint32_t RegisterTraceType() {
+    if constexpr (kEventTrace)
+      return pool::EventTrace::RegisterType(typeid(T).name(), sizeof(T));
+    else
+      return 0;
+  }
+  static inline const uint32_t trace_type_ = RegisterTraceType();
+
+  static inline void Trace(pool::TraceKind kind, const void *ptr,
+                           const void *chunk, uint8_t flags = 0) {
+    if constexpr (kEventTrace)
+      pool::EventTrace::Record(kind, trace_type_, ptr, chunk, flags);
+  }
+
+  // Never destroyed, threads exiting during static destruction still retire
+  // their histograms.
+  static pool::LatencyRegistry &LatencySets() {
+    static pool::LatencyRegistry *registry = new pool::LatencyRegistry();
+    return *registry;
+  }
+
+  inline uint64_t StartLatency() {
+    if constexpr (!kLatencyHistograms)
+      return 0;
+    latency_path_ = pool::LatencyPath::kFast;
+    return pool::LatencyClock::Now();
+  }
+
+  // The call being timed took a slower `path`, the slowest one is kept.
+  inline void MarkLatency(pool::LatencyPath path) {
+    if constexpr (kLatencyHistograms) {
+      if (path > latency_path_)
+        latency_path_ = path;
+    }
+  }
+
+  inline void EndLatency(pool::LatencyOp op, uint64_t start) {
+    if constexpr (kLatencyHistograms)
+      latency_->Record(op, latency_path_, pool::LatencyClock::Now() - start);
+  }
+
   // Calls object's destructor.
-  static inline void DeleteObjectsFromPool(FixedPool *pool) {
-    for (size_t i = 0, blocks_count = pool->GetNumOfBlocks(); i < blocks_count;
-         i++) {
-      if (!pool->IsBlockUsed(i))
-        continue;
-      T *instance = (T *)pool->ToData(pool->AddrFromIndex(i));
-      instance->~T();
+  static inline void DeleteObjectsFromPool(InnerFixedPool *inner_pool) {
+    FixedPool *pool = &inner_pool->pool_instance;
+    if (!pool->IsAnyBlockUsed())
+      return;
+    if (std::atomic<uint64_t> *sampled =
+            inner_pool->sampled_blocks.load(std::memory_order_relaxed)) {
+      pool::HeapProfiler::ForgetRange(inner_pool, kChunkAlignment);
+      size_t words = (pool->GetNumOfBlocks() + 63) / 64;
+      for (size_t i = 0; i < words; i++)
+        sampled[i].store(0, std::memory_order_relaxed);
+    }
+    pool->ReclaimAll([](void *block) { ((T *)block)->~T(); });
+  }
+
+  // The `pool::HeapProfiler` countdown ran out on `block`, never inlined so
+  // the profiler knows how many frames to skip.
+  [[gnu::noinline]] static void SampleBlock(void *block) {
+    if (!pool::HeapProfiler::Record(block, kBlockStride, 1))
+      return;
+    InnerFixedPool *chunk = InnerFixedPool::FromData((T *)block);
+    std::atomic<uint64_t> *sampled =
+        chunk->sampled_blocks.load(std::memory_order_relaxed);
+    if (sampled == nullptr) {
+      size_t words = (chunk->pool_instance.GetNumOfBlocks() + 63) / 64;
+      sampled = new std::atomic<uint64_t>[words]();
+      // Pairs with the acquire in `ForgetSample`, a deleter seeing the array
+      // sees it zeroed.
+      chunk->sampled_blocks.store(sampled, std::memory_order_release);
+    }
+    uint32_t i = chunk->pool_instance.template IndexFromAddr<kBlockStride>(
+        (const unsigned char *)block);
+    sampled[i / 64].fetch_or(1ull << (i % 64), std::memory_order_relaxed);
+  }
+
+  // Any thread, before `instance` is freed. Chunks without samples only cost
+  // the load of `sampled_blocks`, it shares the line with `owner_identifier`.
+  static inline void ForgetSample(InnerFixedPool *chunk, T *instance) {
+    if constexpr (!kHeapSampling)
+      return;
+    std::atomic<uint64_t> *sampled =
+        chunk->sampled_blocks.load(std::memory_order_acquire);
+    if (sampled == nullptr) [[likely]]
+      return;
+    uint32_t i = chunk->pool_instance.template IndexFromAddr<kBlockStride>(
+        (const unsigned char *)instance);
+    uint64_t bit = 1ull << (i % 64);
+    if ((sampled[i / 64].load(std::memory_order_relaxed) & bit) == 0)
+      return;
+    sampled[i / 64].fetch_and(~bit, std::memory_order_relaxed);
+    pool::HeapProfiler::Forget(instance);
+  }
 
-      pool->ForcedDeAllocate((void *)instance);
+  // Hands `count` destroyed objects owned by other threads over, the runs of
+  // consecutive objects from the same chunk are pushed as one chain.
+  static inline void PushRemoteFrees(T **items, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+      InnerFixedPool *chunk = InnerFixedPool::FromData(items[i]);
+      FixedPool *pool = &chunk->pool_instance;
+      size_t last = i;
+      while (last + 1 < count &&
+             InnerFixedPool::FromData(items[last + 1]) == chunk) {
+        pool->LinkBlocks<kBlockStride>(items[last], items[last + 1]);
+        last++;
+      }
+      PoolState::AddThreadFree(chunk, items[i], items[last]);
+      i = last + 1;
+    }
+  }
+
+  void AddRemoteFree(PoolState *owner, T *instance) {
+    if constexpr (Traits::kRemoteFreeBatch == 0) {
+      PoolState::AddThreadFree(InnerFixedPool::FromData(instance), instance,
+                               instance);
+      return;
+    }
+    if (!remote_frees_)
+      remote_frees_ = std::make_unique<RemoteFrees>();
+
+    RemoteFreeSlot *slot = nullptr;
+    RemoteFreeSlot *unused = nullptr;
+    for (RemoteFreeSlot &s : remote_frees_->slots) {
+      if (s.owner == owner) {
+        slot = &s;
+        break;
+      }
+      if (s.owner == nullptr && unused == nullptr)
+        unused = &s;
+    }
+    if (slot == nullptr) {
+      slot = unused;
+      if (slot == nullptr) {
+        slot = &remote_frees_->slots[remote_frees_->next_evict++ %
+                                     kRemoteFreeSlots];
+        slot->Flush();
+        MarkLatency(pool::LatencyPath::kDrain);
+      }
+      slot->owner = owner;
+    }
+
+    slot->items[slot->count++] = instance;
+    if (slot->count == Traits::kRemoteFreeBatch) {
+      slot->Flush();
+      MarkLatency(pool::LatencyPath::kDrain);
     }
   }
 
   static inline void DeleteState(PoolState *state) {
-    std::vector<InnerFixedPool *> &pools = state->pools;
-    for (auto &pool : pools) {
-      DeleteObjectsFromPool(pool->pool_instance);
-      delete pool;
+    // Deletes handed over after the state was orphaned, their objects are
+    // already destroyed.
+    state->CollectThreadFrees();
+
+    InnerFixedPool *pool = state->chunks;
+    while (pool) {
+      InnerFixedPool *next_chunk = pool->next_chunk;
+      DeleteObjectsFromPool(pool);
+      InnerFixedPool::Destroy(pool);
+      pool = next_chunk;
     }
     delete state;
   }
@@ -187,13 +1151,15 @@ private:
   // and returns it.
   inline FixedPool *GetActiveFixedPool() {
     InnerFixedPool *active_pool = state_->next_pool;
-    FixedPool *active_fixed_pool = active_pool->pool_instance;
+    FixedPool *active_fixed_pool = &active_pool->pool_instance;
     if (active_fixed_pool->IsAnyBlockAvailable()) {
       return active_fixed_pool;
     }
 
     // We should do synchronization overhead stuff only when we really need
     // it.
+    MarkLatency(pool::LatencyPath::kDrain);
+    FlushRemoteFrees();
     ConsumeDeallocRequests();
     if (active_fixed_pool->IsAnyBlockAvailable()) {
       return active_fixed_pool;
@@ -201,38 +1167,25 @@ private:
 
     state_->num_free_pools--;
     if (state_->num_free_pools > 0) {
-      InnerFixedPool *next_pool = state_->pools[active_pool->next_id];
-      state_->next_pool = next_pool;
-      active_pool = next_pool;
+      active_pool = active_pool->next_free;
+      state_->next_pool = active_pool;
     } else {
+      MarkLatency(pool::LatencyPath::kGrow);
       active_pool = state_->AddNewPool();
     }
 
-    return active_pool->pool_instance;
+    return &active_pool->pool_instance;
   }
 
+  // We're not calling the destructors, the threads which deleted the objects
+  // already called them. We're just now reclaiming the reserved space as we
+  // need it.
   inline void ConsumeDeallocRequests() {
-    size_t count = 0;
-    T *items[kStackConsumeItems];
-    do {
-      count = state_->dealloc_req_queue.try_dequeue_bulk(
-          state_->consumer_token, items, kStackConsumeItems);
-      for (size_t i = 0; i < count; i++) {
-        T *instance = items[i];
-        InnerFixedPool *inner_pool =
-            (InnerFixedPool *)FixedPool::ReadHeader((void *)instance)
-                ->pool_identifier;
-        FixedPool *pool = inner_pool->pool_instance;
-
-        state_->SetNextFreePool(inner_pool);
-        // We're not calling the destructor, we've already called it. We're just
-        // now reclaiming the reserved space as we need it.
-        //
-        // Safety: The object should've been moved to the *other* thread which
-        // has requested deallocating/deleting this object.
-        pool->ForcedDeAllocate((void *)instance);
-      }
-    } while (count > 0);
+    size_t total = state_->CollectThreadFrees();
+    if (total > 0) {
+      state_->CountFrees(total);
+      Trace(pool::TraceKind::kCollect, (void *)total, nullptr);
+    }
   }
 };
 
@@ -240,61 +1193,355 @@ template <typename T> class PoolManager {
 private:
   friend class Pool<T>;
   using PoolState = Pool<T>::PoolState;
+  using InnerFixedPool = Pool<T>::InnerFixedPool;
+  using Traits = PoolTraits<T>;
+
+  using Queue = moodycamel::ConcurrentQueue<PoolState *>;
+  using ChunkQueue = moodycamel::ConcurrentQueue<InnerFixedPool *>;
+
+  // Lock-free thread-safe queues of orphaned states, one per NUMA node, a
+  // state goes to the queue of the node it was created on.
+  std::unique_ptr<Queue[]> free_pools_;
+  // Fully free chunks donated by the threads of each node, see
+  // `kDepotChunks`. `depot_size_` counts them over every node.
+  std::unique_ptr<ChunkQueue[]> depot_;
+  std::atomic<size_t> depot_size_;
+  // Every state ever created, linked through `next_state`, push only. States
+  // are only deleted at exit, so `Stats` can walk it any time.
+  std::atomic<PoolState *> states_;
+  int num_nodes_;
+
+  int NodeIndex(int node) const {
+    return node >= 0 && node < num_nodes_ ? node : 0;
+  }
 
-  // Lock-free thread-safe queue
-  moodycamel::ConcurrentQueue<PoolState *> free_pools_{};
+  Queue &NodeQueue(int node) { return free_pools_[NodeIndex(node)]; }
 
 public:
-  PoolManager() = default;
+  PoolManager()
+      : free_pools_(new Queue[NumaTopology::NumNodes()]),
+        depot_(new ChunkQueue[NumaTopology::NumNodes()]), depot_size_(0),
+        states_(nullptr), num_nodes_(NumaTopology::NumNodes()) {}
 
   PoolManager(const PoolManager &) = delete;
   PoolManager &operator=(const PoolManager &) = delete;
 
   ~PoolManager() {
     // Program is exiting normally without exceptions/errors...
-    size_t count = 0;
-    PoolState *items[kStackConsumeItems];
-    do {
-      count = free_pools_.try_dequeue_bulk(items, kStackConsumeItems);
-      for (size_t i = 0; i < count; i++) {
-        Pool<T>::DeleteState(items[i]);
-      }
-    } while (count > 0);
+    for (int node = 0; node < num_nodes_; node++) {
+      size_t count = 0;
+      PoolState *items[kStackConsumeItems];
+      do {
+        count = free_pools_[node].try_dequeue_bulk(items, kStackConsumeItems);
+        for (size_t i = 0; i < count; i++) {
+          Pool<T>::DeleteState(items[i]);
+        }
+      } while (count > 0);
+
+      InnerFixedPool *chunk = nullptr;
+      while (depot_[node].try_dequeue(chunk))
+        InnerFixedPool::Destroy(chunk);
+    }
   }
 
   // Gets a thread_local `Pool` instance.
   inline static Pool<T> &Get() { return Pool<T>::Instance(); }
 
+  PoolStats Stats() const {
+    PoolStats stats;
+    for (PoolState *state = states_.load(std::memory_order_acquire);
+         state != nullptr; state = state->next_state) {
+      state->counters.AddTo(stats);
+      stats.states++;
+    }
+    return stats;
+  }
+
 private:
   static PoolManager &Instance() {
     static PoolManager instance = PoolManager();
     return instance;
   }
 
-  void AddFreePool(PoolState *pool) { free_pools_.enqueue(pool); }
+  // Runs from a `thread_local` destructor, the queue's per thread exit
+  // notifier might already be gone by then, so no implicit producer.
+  void AddFreePool(PoolState *pool) {
+    Queue &queue = NodeQueue(pool->numa_node);
+    moodycamel::ProducerToken token(queue);
+    queue.enqueue(token, pool);
+  }
+
+  void AddState(PoolState *state) {
+    state->next_state = states_.load(std::memory_order_relaxed);
+    while (!states_.compare_exchange_weak(state->next_state, state,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed))
+      ;
+  }
 
+  // Prefers states created on the caller's node, then takes one of another
+  // node's. Remote chunks cost more to work on, but a state nobody on its
+  // node comes back for would otherwise stay parked while new ones pile up.
   PoolState *GetFreePool() {
     PoolState *pool = nullptr;
-    if (free_pools_.try_dequeue(pool)) {
-      return pool;
+    int local = NodeIndex(NumaTopology::CurrentNode());
+    for (int i = 0; i < num_nodes_; i++) {
+      if (free_pools_[(local + i) % num_nodes_].try_dequeue(pool))
+        return pool;
     }
     return nullptr;
   }
+
+  // Takes a fully free `chunk` created on `node` if the depot has room. Might
+  // run from a `thread_local` destructor too, see `AddFreePool`, `token` is
+  // the donating state's one for that node's queue.
+  bool DonateChunk(InnerFixedPool *chunk, int node,
+                   std::optional<moodycamel::ProducerToken> &token) {
+    if constexpr (Traits::kDepotChunks == 0)
+      return false;
+    if (depot_size_.fetch_add(1, std::memory_order_relaxed) >=
+        Traits::kDepotChunks) {
+      depot_size_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    if (!token)
+      token.emplace(depot_[NodeIndex(node)]);
+    depot_[NodeIndex(node)].enqueue(*token, chunk);
+    return true;
+  }
+
+  // A chunk donated on the caller's node, nullptr if there is none.
+  InnerFixedPool *TakeChunk() {
+    if constexpr (Traits::kDepotChunks == 0)
+      return nullptr;
+    if (depot_size_.load(std::memory_order_relaxed) == 0)
+      return nullptr;
+    InnerFixedPool *chunk = nullptr;
+    if (!depot_[NodeIndex(NumaTopology::CurrentNode())].try_dequeue(chunk))
+      return nullptr;
+    depot_size_.fetch_sub(1, std::memory_order_relaxed);
+    return chunk;
+  }
 };
 
+// Global side of a magazine mode `Pool<T>`, see `kMagazineSize`. Only
+// instantiated for types which use magazines.
+template <typename T> class MagazineDepot {
+private:
+  friend class Pool<T>;
+  using Magazine = Pool<T>::Magazine;
+  using Traits = PoolTraits<T>;
+  using Queue = moodycamel::ConcurrentQueue<Magazine *>;
+
+  struct Chunk {
+    Chunk *next;
+    size_t size;
+  };
+
+  // A thread's counters, kept after the thread exits and handed to the next
+  // thread which starts, so their sums stay right. A line of its own, the
+  // owner writes them on every call and they are allocated back to back.
+  struct alignas(kCacheLineSize) ThreadCounters {
+    PoolCounters counters;
+    ThreadCounters *next;
+  };
+
+  static constexpr size_t kBlocksOffset =
+      FixedPool::Align(sizeof(Chunk), Pool<T>::kBlockAlignment);
+  // Blocks are never looked up by address, a chunk only needs the alignment
+  // of its first block.
+  static constexpr size_t kChunkAlignment =
+      Pool<T>::kBlockAlignment > kCacheLineSize ? Pool<T>::kBlockAlignment
+                                                : kCacheLineSize;
+
+  Queue full_;
+  Queue empty_;
+  std::atomic<Chunk *> chunks_;
+  std::atomic<size_t> num_chunks_;
+  std::atomic<ThreadCounters *> counters_; // Push only
+  moodycamel::ConcurrentQueue<ThreadCounters *> retired_counters_;
+
+  MagazineDepot() : chunks_(nullptr), num_chunks_(0), counters_(nullptr) {}
+
+  static MagazineDepot &Instance() {
+    static MagazineDepot instance = MagazineDepot();
+    return instance;
+  }
+
+public:
+  MagazineDepot(const MagazineDepot &) = delete;
+  MagazineDepot &operator=(const MagazineDepot &) = delete;
+
+  ~MagazineDepot() {
+    Magazine *magazine = nullptr;
+    while (full_.try_dequeue(magazine))
+      delete magazine;
+    while (empty_.try_dequeue(magazine))
+      delete magazine;
+
+    Chunk *chunk = chunks_.load();
+    while (chunk != nullptr) {
+      Chunk *next = chunk->next;
+      size_t size = chunk->size;
+      FixedPool::FreeChunk(chunk, size, kChunkAlignment, Traits::kBacking);
+      chunk = next;
+    }
+
+    ThreadCounters *counters = counters_.load();
+    while (counters != nullptr) {
+      ThreadCounters *next = counters->next;
+      delete counters;
+      counters = next;
+    }
+  }
+
+  size_t GetNumOfChunks() const { return num_chunks_.load(); }
+
+  PoolStats Stats() const {
+    PoolStats stats;
+    for (ThreadCounters *counters = counters_.load(std::memory_order_acquire);
+         counters != nullptr; counters = counters->next)
+      counters->counters.AddTo(stats);
+    // Only the news and deletes are counted, chunks are never freed.
+    stats.live = stats.news - stats.deletes;
+    stats.new_chunks = stats.chunks = num_chunks_.load();
+    return stats;
+  }
+
+private:
+  // Starts a chunk of `blocks` blocks and returns the address of the first
+  // one, the chunk is only freed at exit.
+  uintptr_t NewChunk(uint32_t blocks) {
+    size_t size = kBlocksOffset + blocks * Pool<T>::kBlockStride;
+    Chunk *chunk = (Chunk *)FixedPool::AllocateChunk(
+        size, kChunkAlignment, Traits::kBacking, NumaTopology::CurrentNode());
+    chunk->size = size;
+    chunk->next = chunks_.load(std::memory_order_relaxed);
+    while (!chunks_.compare_exchange_weak(chunk->next, chunk))
+      ;
+    num_chunks_++;
+    return (uintptr_t)chunk + kBlocksOffset;
+  }
+
+  // The producer tokens live in the calling thread's `MagazineCache`, they
+  // are also used from its `thread_local` destructor, see `AddFreePool`.
+  void PutFull(Magazine *magazine,
+               std::optional<moodycamel::ProducerToken> &token) {
+    if (!token)
+      token.emplace(full_);
+    full_.enqueue(*token, magazine);
+  }
+
+  void PutEmpty(Magazine *magazine,
+                std::optional<moodycamel::ProducerToken> &token) {
+    if (!token)
+      token.emplace(empty_);
+    empty_.enqueue(*token, magazine);
+  }
+
+  Magazine *TakeFull() {
+    Magazine *magazine = nullptr;
+    if (full_.try_dequeue(magazine))
+      return magazine;
+    return nullptr;
+  }
+
+  Magazine *TakeEmpty() {
+    Magazine *magazine = nullptr;
+    if (empty_.try_dequeue(magazine))
+      return magazine;
+    return new Magazine();
+  }
+
+  PoolCounters *TakeCounters() {
+    ThreadCounters *counters = nullptr;
+    if (retired_counters_.try_dequeue(counters))
+      return &counters->counters;
+    counters = new ThreadCounters();
+    counters->next = counters_.load(std::memory_order_relaxed);
+    while (!counters_.compare_exchange_weak(counters->next, counters,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed))
+      ;
+    return &counters->counters;
+  }
+
+  void RetireCounters(PoolCounters *counters) {
+    // `counters` is the first member.
+    retired_counters_.enqueue((ThreadCounters *)counters);
+  }
+};
+
+template <typename T> PoolStats Pool<T>::Stats() {
+  if constexpr (kShared)
+    return SharedPool::Stats();
+  else if constexpr (kMagazines)
+    return MagazineDepot<T>::Instance().Stats();
+  else
+    return PoolManager<T>::Instance().Stats();
+}
+
+template <typename T> pool::LatencyReport Pool<T>::Latencies() {
+  if constexpr (kShared)
+    return SharedPool::Latencies();
+  else
+    return LatencySets().Report();
+}
+
 // Needs to access `PoolManager`
 template <typename T> void Pool<T>::Init() {
+  if constexpr (kShared)
+    return;
+  if constexpr (kLatencyHistograms)
+    latency_ = LatencySets().Take();
+  if constexpr (kMagazines) {
+    magazines_.loaded = MagazineDepot<T>::Instance().TakeEmpty();
+    magazines_.previous = MagazineDepot<T>::Instance().TakeEmpty();
+    magazines_.counters = MagazineDepot<T>::Instance().TakeCounters();
+    return;
+  }
   PoolState *state = PoolManager<T>::Instance().GetFreePool();
-  if (state == nullptr)
+  if (state == nullptr) {
     state = new PoolState();
-  else if (state->num_free_pools == 0)
-    (void)state->AddNewPool();
+    PoolManager<T>::Instance().AddState(state);
+  } else {
+    state->Adopt();
+    if (state->num_free_pools == 0)
+      (void)state->AddNewPool();
+  }
 
   state_ = state;
 }
 
 template <typename T> void Pool<T>::Destroy() {
-  ConsumeDeallocRequests();
+  if constexpr (kShared)
+    return;
+  if constexpr (kLatencyHistograms)
+    LatencySets().Retire(latency_);
+  if constexpr (kMagazines) {
+    MagazineCache &cache = magazines_;
+    MagazineDepot<T> &depot = MagazineDepot<T>::Instance();
+    // What is left of the chunk being carved goes out as full magazines.
+    while (cache.carve != cache.carve_end) {
+      if (cache.loaded->IsFull()) {
+        depot.PutFull(cache.loaded, cache.full_token);
+        cache.loaded = depot.TakeEmpty();
+      }
+      Magazine *loaded = cache.loaded;
+      loaded->blocks[loaded->count++] = (T *)cache.carve;
+      cache.carve += kBlockStride;
+    }
+    for (Magazine *magazine : {cache.loaded, cache.previous}) {
+      if (magazine->count > 0)
+        depot.PutFull(magazine, cache.full_token);
+      else
+        depot.PutEmpty(magazine, cache.empty_token);
+    }
+    depot.RetireCounters(cache.counters);
+    return;
+  }
+  FlushRemoteFrees();
+  state_->Orphan();
   PoolManager<T>::Instance().AddFreePool(state_);
 }
 
@@ -306,6 +1553,81 @@ template <typename T, typename... Args> inline T *New(Args &&...args) {
 template <typename T> inline void Delete(T *instance) {
   Pool<T>::Instance().Delete(instance);
 }
+
+template <typename T> inline void DeleteBatch(std::span<T *> instances) {
+  Pool<T>::Instance().DeleteBatch(instances);
+}
+
+template <typename T> inline void FlushRemoteFrees() {
+  Pool<T>::Instance().FlushRemoteFrees();
+}
+
+template <typename T> inline PoolStats Stats() { return Pool<T>::Stats(); }
+
+template <typename T> inline LatencyReport Latencies() {
+  return Pool<T>::Latencies();
+}
+
+// Empty deleter, keeps `pool::unique_ptr` as wide as a raw pointer. Deletes
+// through the deleting thread's `Pool<T>`, which hands objects owned by another
+// thread back to their owner.
+template <typename T> struct Deleter {
+  void operator()(T *instance) const { Pool<T>::Instance().Delete(instance); }
+};
+
+template <typename T> using unique_ptr = std::unique_ptr<T, Deleter<T>>;
+
+static_assert(sizeof(unique_ptr<int>) == sizeof(int *),
+              "pool::unique_ptr must stay one pointer wide.");
+
+template <typename T, typename... Args>
+inline unique_ptr<T> make_unique(Args &&...args) {
+  return unique_ptr<T>(New<T>(std::forward<Args>(args)...));
+}
+
+template <typename T, typename... Args>
+inline void NewBatch(std::span<T *> out, const Args &...args) {
+  Pool<T>::Instance().NewBatch(out, args...);
+}
+
+template <size_t... I>
+constexpr auto MakeSizeClassTable(std::index_sequence<I...>) {
+  struct Table {
+    void *(*allocate[sizeof...(I)])();
+    void (*free[sizeof...(I)])(void *);
+  };
+  return Table{
+      {+[]() -> void * {
+        using Block = SizeClassBlock<SizeClasses::kSizes[I]>;
+        return Pool<Block>::Instance().New();
+      }...},
+      {+[](void *p) {
+        using Block = SizeClassBlock<SizeClasses::kSizes[I]>;
+        Pool<Block>::Instance().Delete((Block *)p);
+      }...}};
+}
+
+inline constexpr auto kSizeClassTable =
+    MakeSizeClassTable(std::make_index_sequence<SizeClasses::kCount>());
+
+// Type-erased allocation out of the calling thread's size class pools, every
+// block of a class comes from the same chunks whatever type lives in it.
+// `size` must be at most `SizeClasses::kMaxSize` and `alignment` at most a
+// cache line.
+inline void *Allocate(size_t size, size_t alignment = kMinAlignment) {
+  assert(size <= SizeClasses::kMaxSize && alignment <= kCacheLineSize &&
+         "No size class fits the allocation.");
+  return kSizeClassTable.allocate[SizeClasses::Lookup(size, alignment)]();
+}
+
+// Frees a block of `pool::Allocate` from any thread, the class is the block
+// stride of its chunk.
+inline void Free(void *p) {
+  FixedPool *pool =
+      (FixedPool *)FixedPool::ChunkFromAddr(p, SizeClasses::kChunkSize);
+  size_t stride = pool->GetBlockStride();
+  kSizeClassTable.free[SizeClasses::Lookup(stride, 1)](p);
+}
 }; // namespace pool
 
 #endif //__MEMORY_POOL_H__
@@ -0,0 +1,132 @@
+#ifndef __MEMORY_RESOURCE_H__
+#define __MEMORY_RESOURCE_H__
+
+#include <memory_resource>
+#include <optional>
+#include <tuple>
+
+#include "memory_pool.h"
+
+namespace pool {
+// `std::pmr::memory_resource` over the calling thread's size class pools, so
+// `std::pmr` containers get their nodes from thread-local chunks:
+//   pool::MemoryResource resource;
+//   std::pmr::map<int, int> map(&resource);
+//
+// Thread-safe, every thread allocates from its own pools and memory freed on
+// another thread goes back to its owner through the chunk's thread-free list.
+// Every `MemoryResource` shares the same pools, so any of them can free what
+// another one allocated. Allocations no size class fits go to `upstream`.
+class MemoryResource : public std::pmr::memory_resource {
+private:
+  std::pmr::memory_resource *upstream_;
+
+  static inline bool Fits(size_t bytes, size_t alignment) {
+    return bytes <= SizeClasses::kMaxSize && alignment <= kCacheLineSize;
+  }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    if (!Fits(bytes, alignment)) [[unlikely]]
+      return upstream_->allocate(bytes, alignment);
+    return kSizeClassTable.allocate[SizeClasses::Lookup(bytes, alignment)]();
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    if (!Fits(bytes, alignment)) [[unlikely]]
+      return upstream_->deallocate(p, bytes, alignment);
+    kSizeClassTable.free[SizeClasses::Lookup(bytes, alignment)](p);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return dynamic_cast<const MemoryResource *>(&other) != nullptr;
+  }
+
+public:
+  explicit MemoryResource(
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : upstream_(upstream) {}
+
+  std::pmr::memory_resource *upstream_resource() const { return upstream_; }
+};
+
+// Single-threaded flavour, owns a private `Pool` per size class, created on
+// first use, instead of going through the `thread_local` ones. Skips the
+// thread-local lookup and the owner check on every call, but it must only be
+// used by one thread at a time, including deallocations. The pools' chunks go
+// back to the `PoolManager` for reuse when the resource is destroyed.
+class UnsyncMemoryResource : public std::pmr::memory_resource {
+private:
+  template <size_t I>
+  using ClassPool = Pool<SizeClassBlock<SizeClasses::kSizes[I]>>;
+
+  template <size_t... I>
+  static auto MakePools(std::index_sequence<I...>)
+      -> std::tuple<std::optional<ClassPool<I>>...>;
+
+  using Pools =
+      decltype(MakePools(std::make_index_sequence<SizeClasses::kCount>()));
+
+  template <size_t... I>
+  static constexpr auto MakeTable(std::index_sequence<I...>) {
+    struct Table {
+      void *(*allocate[sizeof...(I)])(Pools &);
+      void (*free[sizeof...(I)])(Pools &, void *);
+    };
+    return Table{{+[](Pools &pools) -> void * {
+                   auto &pool = std::get<I>(pools);
+                   if (!pool)
+                     pool.emplace();
+                   return pool->New();
+                 }...},
+                 {+[](Pools &pools, void *p) {
+                   using Block = SizeClassBlock<SizeClasses::kSizes[I]>;
+                   std::get<I>(pools)->Delete((Block *)p);
+                 }...}};
+  }
+
+  static inline const auto &Table() {
+    static constexpr auto table =
+        MakeTable(std::make_index_sequence<SizeClasses::kCount>());
+    return table;
+  }
+
+  Pools pools_;
+  std::pmr::memory_resource *upstream_;
+
+  static inline bool Fits(size_t bytes, size_t alignment) {
+    return bytes <= SizeClasses::kMaxSize && alignment <= kCacheLineSize;
+  }
+
+protected:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    if (!Fits(bytes, alignment)) [[unlikely]]
+      return upstream_->allocate(bytes, alignment);
+    return Table().allocate[SizeClasses::Lookup(bytes, alignment)](pools_);
+  }
+
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    if (!Fits(bytes, alignment)) [[unlikely]]
+      return upstream_->deallocate(p, bytes, alignment);
+    Table().free[SizeClasses::Lookup(bytes, alignment)](pools_, p);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+public:
+  explicit UnsyncMemoryResource(
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      : upstream_(upstream) {}
+
+  UnsyncMemoryResource(const UnsyncMemoryResource &) = delete;
+  UnsyncMemoryResource &operator=(const UnsyncMemoryResource &) = delete;
+
+  std::pmr::memory_resource *upstream_resource() const { return upstream_; }
+};
+}; // namespace pool
+
+#endif //__MEMORY_RESOURCE_H__
@@ -0,0 +1,87 @@
+#ifndef __POOL_ALLOCATOR_H__
+#define __POOL_ALLOCATOR_H__
+
+#include <memory>
+#include <type_traits>
+
+#include "memory_pool.h"
+
+// Storage of one `T` handed out by `PoolAllocator<T>`, the default constructor
+// leaves it uninitialized so the container constructs the element itself.
+template <typename T> struct AllocatorBlock {
+  AllocatorBlock() {}
+  alignas(T) unsigned char bytes[sizeof(T)];
+};
+
+// The blocks are tuned like the type they store, e.g. node types can share a
+// size class through `kShareSizeClass`.
+template <typename T>
+struct PoolTraits<AllocatorBlock<T>> : PoolTraits<T> {};
+
+// Standard allocator over the thread-local pools, for node based containers:
+//   std::map<int, Order, std::less<int>,
+//            PoolAllocator<std::pair<const int, Order>>> orders;
+//
+// Containers rebind it to their node type, so every node comes from the
+// calling thread's `Pool<AllocatorBlock<Node>>` chunks. Allocations of more
+// than one element(vector storage, hash buckets) go to `std::allocator`.
+// Stateless, any instance can free what another one allocated, from any
+// thread, the owner of a block is found from its address.
+template <typename T> class PoolAllocator {
+private:
+  using Block = AllocatorBlock<T>;
+
+public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+  using is_always_equal = std::true_type;
+
+  template <typename U> struct rebind {
+    using other = PoolAllocator<U>;
+  };
+
+  PoolAllocator() noexcept = default;
+  template <typename U> PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) {
+    if (n == 1) [[likely]]
+      return (T *)Pool<Block>::Instance().New();
+    return std::allocator<T>().allocate(n);
+  }
+
+  void deallocate(T *p, size_t n) {
+    if (n == 1) [[likely]] {
+      Pool<Block>::Instance().Delete((Block *)p);
+      return;
+    }
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U> &) const noexcept {
+    return true;
+  }
+};
+
+namespace pool {
+// `std::shared_ptr` whose reference counts live in the same block as the
+// object. `std::allocate_shared` rebinds the allocator to its in-place control
+// block type, so the combined layout gets a `Pool` of its own and the last
+// release returns the block to the owner thread like `pool::Delete` does.
+template <typename T, typename U, typename... Args>
+inline std::shared_ptr<T> allocate_shared(const PoolAllocator<U> &alloc,
+                                          Args &&...args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(alloc),
+                                 std::forward<Args>(args)...);
+}
+
+template <typename T, typename... Args>
+inline std::shared_ptr<T> make_shared(Args &&...args) {
+  return std::allocate_shared<T>(PoolAllocator<T>(),
+                                 std::forward<Args>(args)...);
+}
+}; // namespace pool
+
+#endif //__POOL_ALLOCATOR_H__
@@ -6,3 +6,5 @@ fi
 
 g++ -std=c++20 -Wall -Werror -ggdb test.cpp ../fixed_pool.cpp -I../ -o build/test
 g++ -std=c++20 -Wall -Werror -ggdb test_obj_moved.cpp ../fixed_pool.cpp -I../ -o build/test_obj_moved
+g++ -std=c++20 -Wall -Werror -ggdb test_trace.cpp ../fixed_pool.cpp -I../ -o build/test_trace
+g++ -std=c++20 -Wall -Werror -ggdb test_latency.cpp ../fixed_pool.cpp -I../ -o build/test_latency
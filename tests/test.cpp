@@ -1,6 +1,15 @@
+#include "arena.h"
 #include "memory_pool.h"
+#include "pool_allocator.h"
+#include "memory_resource.h"
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <unordered_map>
 #include <thread>
 
 struct MyObj {
@@ -73,6 +82,30 @@ int test_fixed_pool() {
   return 0;
 }
 
+int test_static_fixed_pool() {
+  std::cout << "\nTest" << ++test_count
+            << ": Directly using compile-time sized fixed pool to allocate "
+               "two `MyObj`\n";
+  StaticFixedPool<sizeof(MyObj), 2, alignof(MyObj)> pool;
+
+  MyObj *parent = new (pool.Allocate()) MyObj("Parent", 0);
+  MyObj *child = new (pool.Allocate()) MyObj("Child", 1);
+  child->setParent(parent);
+
+  std::cout << child->objNum << ": " << child->objName << "\n";
+  std::cout << parent->objNum << ": " << parent->objName << "\n";
+
+  if (pool.IsAnyBlockAvailable() || pool.Allocate() != nullptr)
+    return 1;
+
+  child->~MyObj();
+  pool.DeAllocate(child);
+  parent->~MyObj();
+  pool.DeAllocate(parent);
+
+  return pool.IsAnyBlockUsed() ? 1 : 0;
+}
+
 void create_my_objs(MyObj **ret_parent, MyObj **ret_child) {
   auto &manager = PoolManager<MyObj>::Get();
   MyObj *parent = manager.New("Parent", 2);
@@ -250,6 +283,584 @@ int test_pool_manager7() {
   return 0;
 }
 
+struct PairChunkObj {
+  uint64_t num;
+};
+
+template <> struct PoolTraits<PairChunkObj> : DefaultPoolTraits {
+  static constexpr uint32_t kInitialBlockCount = 2;
+  static constexpr uint32_t kMaxBlockCount = 2;
+  static constexpr uint32_t kReleaseInterval = 0;
+};
+
+int test_pool_manager8() {
+  std::cout << "\nTest" << ++test_count
+            << ": Freeing into a full active `FixedPool` and allocating past "
+               "it again\n";
+
+  std::vector<int *> objs;
+  for (size_t i = 0; i < kDefaultBlockCount; i++)
+    objs.push_back(pool::New<int>(i));
+
+  // Blocks don't carry a header anymore, neighbours are `sizeof(int)` apart.
+  if ((uintptr_t)objs[1] - (uintptr_t)objs[0] != sizeof(int))
+    return 1;
+
+  pool::Delete(objs[3]);
+  int *reused = pool::New<int>(3);
+  int *next = pool::New<int>(kDefaultBlockCount);
+  printf("reused: %p, next: %p\n", reused, next);
+  if (reused != objs[3] || next == reused)
+    return 1;
+
+  for (size_t i = 0; i < kDefaultBlockCount; i++) {
+    if (i != 3)
+      pool::Delete(objs[i]);
+  }
+  pool::Delete(reused);
+  pool::Delete(next);
+
+  // Freeing into an older full chunk while the active one is full, the full
+  // active chunk must not be handed out again once the older one fills up.
+  PairChunkObj *a0 = pool::New<PairChunkObj>(PairChunkObj{0});
+  PairChunkObj *a1 = pool::New<PairChunkObj>(PairChunkObj{1});
+  PairChunkObj *b0 = pool::New<PairChunkObj>(PairChunkObj{2});
+  PairChunkObj *b1 = pool::New<PairChunkObj>(PairChunkObj{3});
+  pool::Delete(a0);
+  PairChunkObj *x = pool::New<PairChunkObj>(PairChunkObj{4});
+  PairChunkObj *y = pool::New<PairChunkObj>(PairChunkObj{5});
+  if (x != a0 || y == a1 || y == b0 || y == b1 || y == x ||
+      Pool<PairChunkObj>::Instance().GetNumOfChunks() != 3)
+    return 1;
+  for (PairChunkObj *obj : {a1, b0, b1, x, y})
+    pool::Delete(obj);
+
+  return 0;
+}
+
+struct alignas(32) SimdObj {
+  float lanes[8];
+};
+
+struct Counter {
+  uint64_t hits;
+};
+
+struct StraddleObj {
+  char bytes[24];
+};
+
+template <> struct PoolTraits<Counter> : DefaultPoolTraits {
+  static constexpr StrideMode kStrideMode = StrideMode::kWholeCacheLines;
+};
+
+template <> struct PoolTraits<StraddleObj> : DefaultPoolTraits {
+  static constexpr StrideMode kStrideMode = StrideMode::kNoCacheLineStraddle;
+};
+
+int test_pool_manager9() {
+  std::cout << "\nTest" << ++test_count
+            << ": Honoring `alignof(T)` and the cache line stride modes\n";
+
+  std::vector<SimdObj *> simd_objs;
+  std::vector<Counter *> counters;
+  std::vector<StraddleObj *> straddle_objs;
+  for (size_t i = 0; i < kDefaultBlockCount * 2; i++) {
+    simd_objs.push_back(pool::New<SimdObj>());
+    counters.push_back(pool::New<Counter>(Counter{i}));
+    straddle_objs.push_back(pool::New<StraddleObj>());
+  }
+
+  int result = 0;
+  for (size_t i = 0; i < simd_objs.size(); i++) {
+    uintptr_t straddle_obj = (uintptr_t)straddle_objs[i];
+    if ((uintptr_t)simd_objs[i] % alignof(SimdObj) != 0 ||
+        (uintptr_t)counters[i] % kCacheLineSize != 0 ||
+        straddle_obj / kCacheLineSize !=
+            (straddle_obj + sizeof(StraddleObj) - 1) / kCacheLineSize) {
+      printf("Misplaced: %p %p %p\n", simd_objs[i], counters[i],
+             straddle_objs[i]);
+      result = 1;
+    }
+  }
+
+  for (size_t i = 0; i < simd_objs.size(); i++) {
+    pool::Delete(simd_objs[i]);
+    pool::Delete(counters[i]);
+    pool::Delete(straddle_objs[i]);
+  }
+
+  return result;
+}
+
+struct MmapObj {
+  uint64_t a, b;
+};
+
+struct HugeObj {
+  uint64_t a, b;
+};
+
+template <> struct PoolTraits<MmapObj> : DefaultPoolTraits {
+  static constexpr ChunkBacking kBacking = ChunkBacking::kMmap;
+};
+
+template <> struct PoolTraits<HugeObj> : DefaultPoolTraits {
+  static constexpr ChunkBacking kBacking = ChunkBacking::kHugePages;
+};
+
+int test_pool_manager10() {
+  std::cout << "\nTest" << ++test_count
+            << ": Page backed chunks are filled up to whole pages\n";
+
+  // The first 4 KiB page takes ~250 blocks of 16 bytes, the next chunk
+  // doubles that, while a single 2 MiB page holds all of them.
+  std::vector<MmapObj *> mmap_objs;
+  std::vector<HugeObj *> huge_objs;
+  for (uint64_t i = 0; i < 512; i++) {
+    mmap_objs.push_back(pool::New<MmapObj>(MmapObj{i, i}));
+    huge_objs.push_back(pool::New<HugeObj>(HugeObj{i, i}));
+  }
+
+  size_t mmap_chunks = Pool<MmapObj>::Instance().GetNumOfChunks();
+  size_t huge_chunks = Pool<HugeObj>::Instance().GetNumOfChunks();
+  std::cout << "Chunks: mmap: " << mmap_chunks << ", huge: " << huge_chunks
+            << "\n";
+
+  int result = (mmap_chunks == 2 && huge_chunks == 1) ? 0 : 1;
+  for (uint64_t i = 0; i < mmap_objs.size(); i++) {
+    if (mmap_objs[i]->a != i || huge_objs[i]->b != i)
+      result = 1;
+    pool::Delete(mmap_objs[i]);
+    pool::Delete(huge_objs[i]);
+  }
+
+  return result;
+}
+
+struct CountedObj {
+  static inline size_t destroyed = 0;
+  ~CountedObj() { destroyed++; }
+  uint64_t num;
+};
+
+int test_pool_manager11() {
+  std::cout << "\nTest" << ++test_count
+            << ": Clearing a sparsely used pool only destroys the live "
+               "objects\n";
+
+  auto &counted_pool = Pool<CountedObj>::Instance();
+  std::vector<CountedObj *> objs;
+  for (uint64_t i = 0; i < 5000; i++)
+    objs.push_back(counted_pool.New(CountedObj{i}));
+
+  size_t live = 0;
+  for (size_t i = 0; i < objs.size(); i++) {
+    if (i % 97 == 0)
+      live++;
+    else
+      counted_pool.Delete(objs[i]);
+  }
+
+  CountedObj::destroyed = 0;
+  counted_pool.Clear();
+  std::cout << "Live: " << live << ", destroyed: " << CountedObj::destroyed
+            << "\n";
+  if (CountedObj::destroyed != live)
+    return 1;
+
+  // Every block is free again.
+  CountedObj::destroyed = 0;
+  counted_pool.Clear();
+  return CountedObj::destroyed == 0 ? 0 : 1;
+}
+
+struct ChainNode {
+  static inline size_t destroyed = 0;
+  ChainNode(uint64_t p_num) : num(p_num) {}
+  ~ChainNode() { destroyed++; }
+  uint64_t num;
+  pool::unique_ptr<ChainNode> child;
+};
+
+// Small chunks, released on every check, so the deletes the destructors make
+// would release chunks `Clear` is still walking.
+template <> struct PoolTraits<ChainNode> : DefaultPoolTraits {
+  static constexpr uint32_t kInitialBlockCount = 4;
+  static constexpr uint32_t kMaxBlockCount = 4;
+  static constexpr uint32_t kReleaseInterval = 1;
+  static constexpr uint32_t kReserveChunks = 0;
+  static constexpr uint32_t kDepotChunks = 0;
+};
+
+static ChainNode *NewChain(uint64_t length) {
+  ChainNode *head = pool::New<ChainNode>(0);
+  ChainNode *node = head;
+  for (uint64_t i = 1; i < length; i++) {
+    node->child = pool::make_unique<ChainNode>(i);
+    node = node->child.get();
+  }
+  return head;
+}
+
+int test_pool_manager12() {
+  std::cout << "\nTest" << ++test_count
+            << ": Clearing objects whose destructors delete other objects of "
+               "the pool\n";
+
+  auto &chain_pool = Pool<ChainNode>::Instance();
+  NewChain(10);
+  ChainNode::destroyed = 0;
+  chain_pool.Clear();
+  size_t short_chain = ChainNode::destroyed;
+
+  NewChain(100);
+  NewChain(37);
+  ChainNode::destroyed = 0;
+  chain_pool.Clear();
+  size_t long_chains = ChainNode::destroyed;
+
+  // Every block is free exactly once.
+  std::vector<ChainNode *> nodes;
+  for (uint64_t i = 0; i < 64; i++)
+    nodes.push_back(chain_pool.New(i));
+  std::vector<ChainNode *> sorted = nodes;
+  std::sort(sorted.begin(), sorted.end());
+  bool unique =
+      std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+  for (ChainNode *node : nodes)
+    chain_pool.Delete(node);
+
+  std::cout << "Destroyed: " << short_chain << ", " << long_chains
+            << ", unique: " << unique << "\n";
+  return short_chain == 10 && long_chains == 137 && unique &&
+                 Pool<ChainNode>::Stats().live == 0
+             ? 0
+             : 1;
+}
+
+struct SharedA {
+  SharedA(uint32_t p_num) : num(p_num) {}
+  uint32_t num;
+  uint32_t pad[5];
+};
+
+struct SharedB {
+  static inline size_t destroyed = 0;
+  SharedB(uint64_t p_num) : num(p_num) {}
+  ~SharedB() { destroyed++; }
+  uint64_t num;
+  uint64_t pad[2];
+};
+
+template <> struct PoolTraits<SharedA> : DefaultPoolTraits {
+  static constexpr bool kShareSizeClass = true;
+};
+template <> struct PoolTraits<SharedB> : DefaultPoolTraits {
+  static constexpr bool kShareSizeClass = true;
+};
+
+int test_pool_manager13() {
+  std::cout << "\nTest" << ++test_count
+            << ": Types and raw allocations of the same size class share "
+               "chunks\n";
+
+  auto chunk_of = [](void *p) {
+    return FixedPool::ChunkFromAddr(p, SizeClasses::kChunkSize);
+  };
+
+  // 24 bytes each, both live in the 24 bytes class.
+  SharedA *a = pool::New<SharedA>(1u);
+  SharedB *b = pool::New<SharedB>(2u);
+  void *raw = pool::Allocate(20, 8);
+  if (chunk_of(a) != chunk_of(b) || chunk_of(b) != chunk_of(raw))
+    return 1;
+  if (Pool<SharedA>::Instance().GetNumOfChunks() != 1)
+    return 1;
+
+  pool::Delete(b);
+  if (SharedB::destroyed != 1)
+    return 1;
+  // The freed block is reused by the other type.
+  SharedA *a2 = pool::New<SharedA>(3u);
+  if ((void *)a2 != (void *)b)
+    return 1;
+
+  // Over-aligned requests move up to a class aligned enough.
+  void *aligned = pool::Allocate(40, 32);
+  if (!FixedPool::IsAligned((uintptr_t)aligned, 32))
+    return 1;
+
+  // Freed from another thread, reused after the owner consumes it.
+  std::thread t1(+[](void *p) { pool::Free(p); }, raw);
+  t1.join();
+  std::vector<void *> blocks;
+  bool reused = false;
+  for (int i = 0; i < 1000 && !reused; i++) {
+    blocks.push_back(pool::Allocate(24));
+    reused = blocks.back() == raw;
+  }
+  for (void *p : blocks)
+    pool::Free(p);
+
+  pool::Delete(a);
+  pool::Delete(a2);
+  pool::Free(aligned);
+  return reused ? 0 : 1;
+}
+
+template <typename Resource> int test_memory_resource() {
+  Resource resource;
+  std::pmr::map<uint32_t, std::pmr::string> map(&resource);
+  std::pmr::list<uint64_t> list(&resource);
+  for (uint32_t i = 0; i < 5000; i++) {
+    map.emplace(i, std::to_string(i));
+    list.push_back(i);
+  }
+  // Too big for any size class, goes upstream.
+  std::pmr::vector<uint64_t> big(4096, 7, &resource);
+
+  for (uint32_t i = 0; i < 5000; i += 2)
+    map.erase(i);
+  if (map.size() != 2500 || map.at(4999) != "4999" || list.back() != 4999 ||
+      big[4095] != 7)
+    return 1;
+
+  void *p = resource.allocate(48, 16);
+  if (!FixedPool::IsAligned((uintptr_t)p, 16))
+    return 1;
+  resource.deallocate(p, 48, 16);
+  return resource.is_equal(resource) ? 0 : 1;
+}
+
+int test_pool_manager14() {
+  std::cout << "\nTest" << ++test_count
+            << ": std::pmr containers on the pool memory resources\n";
+
+  if (test_memory_resource<pool::MemoryResource>() != 0)
+    return 1;
+  if (test_memory_resource<pool::UnsyncMemoryResource>() != 0)
+    return 1;
+
+  pool::MemoryResource resource, other;
+  pool::UnsyncMemoryResource unsync, other_unsync;
+  if (!resource.is_equal(other) || unsync.is_equal(other_unsync) ||
+      resource.is_equal(unsync))
+    return 1;
+
+  // Freed on another thread, the owner gets it back through the chunk.
+  void *p = resource.allocate(100, 8);
+  std::thread t1(
+      +[](pool::MemoryResource *r, void *block) {
+        r->deallocate(block, 100, 8);
+      },
+      &resource, p);
+  t1.join();
+  std::vector<void *> blocks;
+  bool reused = false;
+  for (int i = 0; i < 1000 && !reused; i++) {
+    blocks.push_back(resource.allocate(100, 8));
+    reused = blocks.back() == p;
+  }
+  for (void *block : blocks)
+    other.deallocate(block, 100, 8);
+
+  return reused ? 0 : 1;
+}
+
+int test_pool_manager15() {
+  std::cout << "\nTest" << ++test_count
+            << ": Node based containers on PoolAllocator\n";
+
+  using OrderMap =
+      std::map<uint64_t, std::string, std::less<uint64_t>,
+               PoolAllocator<std::pair<const uint64_t, std::string>>>;
+  OrderMap orders;
+  std::list<uint32_t, PoolAllocator<uint32_t>> list;
+  std::set<uint32_t, std::less<uint32_t>, PoolAllocator<uint32_t>> set;
+  std::unordered_map<uint32_t, uint32_t, std::hash<uint32_t>,
+                     std::equal_to<uint32_t>,
+                     PoolAllocator<std::pair<const uint32_t, uint32_t>>>
+      hash_map;
+  // Multi element allocations go to `std::allocator`.
+  std::vector<uint64_t, PoolAllocator<uint64_t>> vec;
+
+  for (uint32_t i = 0; i < 10000; i++) {
+    orders.emplace(i, std::to_string(i));
+    list.push_back(i);
+    set.insert(i);
+    hash_map.emplace(i, i);
+    vec.push_back(i);
+  }
+  for (uint32_t i = 0; i < 10000; i += 3) {
+    orders.erase(i);
+    set.erase(i);
+    hash_map.erase(i);
+  }
+  if (orders.size() != 6666 || orders.at(9998) != "9998" ||
+      set.count(9998) != 1 || hash_map.at(9998) != 9998 ||
+      list.size() != 10000 || vec[9999] != 9999)
+    return 1;
+
+  PoolAllocator<uint32_t> a;
+  PoolAllocator<uint64_t> b(a);
+  if (!(a == b))
+    return 1;
+
+  // The nodes are owned by this thread, the other thread destroys the map
+  // and they come back through the thread-free lists.
+  OrderMap *moved = new OrderMap(orders);
+  std::thread t1(+[](OrderMap *m) { delete m; }, moved);
+  t1.join();
+  orders.clear();
+  return orders.empty() ? 0 : 1;
+}
+
+struct StatsObj {
+  uint64_t num;
+};
+
+int test_pool_manager16() {
+  std::cout << "\nTest" << ++test_count
+            << ": Allocation counters summed over every thread\n";
+
+  std::vector<StatsObj *> objs;
+  for (uint64_t i = 0; i < 100; i++)
+    objs.push_back(pool::New<StatsObj>(StatsObj{i}));
+  for (size_t i = 0; i < 10; i++)
+    pool::Delete(objs[i]);
+
+  PoolStats stats = pool::Stats<StatsObj>();
+  if (stats.news != 100 || stats.deletes != 10 || stats.live != 90 ||
+      stats.peak_live != 100 ||
+      stats.chunks != Pool<StatsObj>::Instance().GetNumOfChunks() ||
+      stats.new_chunks != stats.chunks || stats.states != 1)
+    return 1;
+
+  // Another thread frees 40 of them and allocates 5 of its own.
+  std::thread t1(
+      +[](StatsObj **remote) {
+        for (size_t i = 0; i < 40; i++)
+          pool::Delete(remote[i]);
+        pool::FlushRemoteFrees<StatsObj>();
+        for (uint64_t i = 0; i < 5; i++)
+          pool::Delete(pool::New<StatsObj>(StatsObj{i}));
+      },
+      objs.data() + 10);
+  t1.join();
+  stats = pool::Stats<StatsObj>();
+  if (stats.remote_sent != 40 || stats.remote_received != 0 ||
+      stats.news != 105 || stats.states != 2)
+    return 1;
+
+  // The remote deletes are received once this thread runs out of blocks.
+  while (stats.remote_received == 0) {
+    objs.push_back(pool::New<StatsObj>(StatsObj{0}));
+    stats = pool::Stats<StatsObj>();
+  }
+  std::cout << "News: " << stats.news << ", live: " << stats.live
+            << ", received: " << stats.remote_received << "\n";
+  if (stats.remote_received != 40 || stats.drains != 1 ||
+      stats.live != objs.size() - 50)
+    return 1;
+
+  for (size_t i = 50; i < objs.size(); i++)
+    pool::Delete(objs[i]);
+  return pool::Stats<StatsObj>().live == 0 ? 0 : 1;
+}
+
+struct ProfiledObj {
+  uint64_t num;
+  uint64_t pad[7];
+};
+
+int test_pool_manager17() {
+  std::cout << "\nTest" << ++test_count
+            << ": Sampled blocks stay in the heap profile until deleted\n";
+
+  size_t before = pool::HeapProfiler::GetNumOfLiveSamples();
+  // About one sample per block.
+  pool::HeapProfiler::SetSampleRate(sizeof(ProfiledObj));
+  std::vector<ProfiledObj *> objs;
+  for (uint64_t i = 0; i < 1000; i++)
+    objs.push_back(pool::New<ProfiledObj>(ProfiledObj{i, {}}));
+  pool::HeapProfiler::SetSampleRate(0);
+
+  size_t sampled = pool::HeapProfiler::GetNumOfLiveSamples() - before;
+  std::cout << "Sampled: " << sampled << "\n";
+  if (sampled < 100 || sampled > 1000)
+    return 1;
+
+  std::stringstream profile;
+  pool::HeapProfiler::WriteProfile(profile);
+  std::string text = profile.str();
+  if (text.rfind("heap profile: ", 0) != 0 ||
+      text.find("MAPPED_LIBRARIES:") == std::string::npos)
+    return 1;
+
+  // Deleted on another thread, the samples go away with the blocks.
+  std::thread t1(
+      +[](std::vector<ProfiledObj *> *moved) {
+        for (size_t i = 0; i < moved->size(); i += 2)
+          pool::Delete((*moved)[i]);
+      },
+      &objs);
+  t1.join();
+  size_t left = pool::HeapProfiler::GetNumOfLiveSamples() - before;
+  if (left == 0 || left >= sampled)
+    return 1;
+
+  for (size_t i = 1; i < objs.size(); i += 2)
+    pool::Delete(objs[i]);
+  return pool::HeapProfiler::GetNumOfLiveSamples() == before ? 0 : 1;
+}
+
+struct ArenaObj {
+  static inline std::vector<uint32_t> destroyed;
+  ArenaObj(uint32_t p_num) : num(p_num) {}
+  ~ArenaObj() { destroyed.push_back(num); }
+  uint32_t num;
+};
+
+struct alignas(64) ArenaVec {
+  float v[16];
+};
+
+int test_arena() {
+  std::cout << "\nTest" << ++test_count
+            << ": Arena bump allocates mixed types and destroys them on "
+               "Reset\n";
+
+  pool::Arena arena(4096);
+  for (uint32_t round = 0; round < 2; round++) {
+    ArenaObj::destroyed.clear();
+    for (uint32_t i = 0; i < 200; i++) {
+      ArenaObj *obj = arena.New<ArenaObj>(i);
+      ArenaVec *vec = arena.New<ArenaVec>();
+      uint64_t *num = arena.New<uint64_t>(i);
+      if (obj->num != i || *num != i ||
+          !FixedPool::IsAligned((uintptr_t)vec, alignof(ArenaVec)))
+        return 1;
+    }
+    // Bigger than a chunk, gets one of its own.
+    auto *big = (unsigned char *)arena.Allocate(3 * 4096);
+    memset(big, 0xAA, 3 * 4096);
+
+    size_t chunks = arena.GetNumOfChunks();
+    std::cout << "Round " << round << ": " << chunks << " chunks\n";
+    arena.Reset();
+    if (arena.GetNumOfChunks() != chunks - 1)
+      return 1;
+
+    // Only `ArenaObj` has a destructor, newest first.
+    if (ArenaObj::destroyed.size() != 200 || ArenaObj::destroyed[0] != 199 ||
+        ArenaObj::destroyed[199] != 0)
+      return 1;
+  }
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
 #define defer_return(v)                                                        \
   do {                                                                         \
@@ -261,6 +872,8 @@ int main(int argc, char **argv) {
 
   if (test_fixed_pool() != 0)
     defer_return(1);
+  if (test_static_fixed_pool() != 0)
+    defer_return(1);
   if (test_pool_manager() != 0)
     defer_return(1);
   if (test_pool_manager2() != 0)
@@ -279,6 +892,28 @@ int main(int argc, char **argv) {
 
   if (test_pool_manager7() != 0)
     defer_return(1);
+  if (test_pool_manager8() != 0)
+    defer_return(1);
+  if (test_pool_manager9() != 0)
+    defer_return(1);
+  if (test_pool_manager10() != 0)
+    defer_return(1);
+  if (test_pool_manager11() != 0)
+    defer_return(1);
+  if (test_pool_manager12() != 0)
+    defer_return(1);
+  if (test_pool_manager13() != 0)
+    defer_return(1);
+  if (test_pool_manager14() != 0)
+    defer_return(1);
+  if (test_pool_manager15() != 0)
+    defer_return(1);
+  if (test_pool_manager16() != 0)
+    defer_return(1);
+  if (test_pool_manager17() != 0)
+    defer_return(1);
+  if (test_arena() != 0)
+    defer_return(1);
 
   printf("\nAll %d Tests passed\n", test_count);
 defer:
@@ -0,0 +1,87 @@
+// Tests of the `MEMORY_POOL_LATENCY` build, kept apart so the other tests
+// run with New/Delete untimed.
+#define FIXED_POOL_BLOCK_COUNT 2
+#define MEMORY_POOL_LATENCY 1
+
+#include "memory_pool.h"
+#include <iostream>
+#include <thread>
+#include <vector>
+
+static int test_count = 0;
+
+struct LatencyObj {
+  uint64_t value;
+};
+
+int test1() {
+  std::cout << "\nTest" << ++test_count
+            << ": Latencies are split by the path New/Delete took\n";
+
+  std::vector<LatencyObj *> objs;
+  for (uint64_t i = 0; i < 8; i++)
+    objs.push_back(pool::New<LatencyObj>(LatencyObj{i}));
+  for (size_t i = 0; i < 4; i++)
+    pool::Delete(objs[i]);
+  std::thread t(
+      +[](LatencyObj **moved) {
+        for (size_t i = 0; i < 4; i++)
+          pool::Delete(moved[i]);
+        pool::FlushRemoteFrees<LatencyObj>();
+      },
+      objs.data() + 4);
+  t.join();
+  // Runs out of blocks and collects the remote deletes.
+  for (uint64_t i = 0; i < 8; i++)
+    objs[i] = pool::New<LatencyObj>(LatencyObj{i});
+  for (LatencyObj *obj : objs)
+    pool::Delete(obj);
+
+  pool::LatencyReport report = pool::Latencies<LatencyObj>();
+  report.Write(std::cout, "LatencyObj");
+  using pool::LatencyOp;
+  using pool::LatencyPath;
+  const pool::LatencyStats &news = report.Get(LatencyOp::kNew);
+  const pool::LatencyStats &deletes = report.Get(LatencyOp::kDelete);
+  if (news.count != 16 || deletes.count != 16)
+    return 1;
+  if (report.Get(LatencyOp::kNew, LatencyPath::kFast).count == 0 ||
+      report.Get(LatencyOp::kNew, LatencyPath::kDrain).count == 0 ||
+      report.Get(LatencyOp::kNew, LatencyPath::kGrow).count == 0 ||
+      report.Get(LatencyOp::kDelete, LatencyPath::kFast).count == 0)
+    return 1;
+  for (const pool::LatencyStats *stats : {&news, &deletes}) {
+    if (!(stats->p50 <= stats->p99 && stats->p99 <= stats->p999 &&
+          stats->p999 <= stats->max && stats->max > 0))
+      return 1;
+  }
+
+  // Bucket bounds stay within 1/16th of the value.
+  for (uint64_t value : {0ull, 15ull, 16ull, 17ull, 1000ull, 123456789ull}) {
+    uint64_t bound = pool::LatencyHistogram::UpperBound(
+        pool::LatencyHistogram::Index(value));
+    if (bound < value || bound - value > value / 16)
+      return 1;
+  }
+  return 0;
+}
+
+int main() {
+#define defer_return(v)                                                        \
+  do {                                                                         \
+    result = (v);                                                              \
+    goto defer;                                                                \
+  } while (0)
+
+  int result = 0;
+
+  if (test1() != 0)
+    defer_return(1);
+
+  printf("\nAll %d Tests passed\n", test_count);
+defer:
+  if (result != 0) {
+    printf("\n%d Tests passed, some other test failed\n", test_count - 1);
+  }
+  return result;
+}
@@ -2,6 +2,9 @@
 #define FIXED_POOL_BLOCK_COUNT 2
 
 #include "memory_pool.h"
+#include "pool_allocator.h"
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iostream>
 #include <thread>
@@ -109,6 +112,580 @@ int test2() {
   return is_0th_pool_reused ? 0 : 1;
 }
 
+int test3() {
+  std::cout << "\nTest" << ++test_count
+            << ": Every new pool doubles the blocks of the previous one\n";
+
+  struct Node {
+    uint32_t num;
+  };
+  auto &node_pool = Pool<Node>::Instance();
+
+  // 2 + 4 + 8 blocks
+  std::vector<Node *> nodes;
+  for (uint32_t i = 0; i < kDefaultBlockCount * 7; i++)
+    nodes.push_back(node_pool.New(Node{i}));
+  size_t chunks = node_pool.GetNumOfChunks();
+
+  nodes.push_back(node_pool.New(Node{0}));
+  size_t grown_chunks = node_pool.GetNumOfChunks();
+  std::cout << "Chunks: " << chunks << " -> " << grown_chunks << "\n";
+
+  for (auto node : nodes)
+    pool::Delete(node);
+
+  return (chunks == 3 && grown_chunks == 4) ? 0 : 1;
+}
+
+struct ReleaseNode {
+  uint32_t num;
+};
+
+template <> struct PoolTraits<ReleaseNode> : DefaultPoolTraits {
+  static constexpr uint32_t kReleaseInterval = 8;
+  static constexpr uint32_t kReserveChunks = 1;
+};
+
+int test4() {
+  std::cout << "\nTest" << ++test_count
+            << ": Idle free pools are released, keeping a reserve\n";
+
+  auto &node_pool = Pool<ReleaseNode>::Instance();
+
+  // 2 + 4 + 8 blocks
+  std::vector<ReleaseNode *> nodes;
+  for (uint32_t i = 0; i < kDefaultBlockCount * 7; i++)
+    nodes.push_back(node_pool.New(ReleaseNode{i}));
+  size_t chunks = node_pool.GetNumOfChunks();
+
+  for (auto node : nodes)
+    pool::Delete(node);
+
+  // Keeps freeing from the active pool until the two idle pools were seen
+  // unused by two checks, one of those is kept as the reserve.
+  for (uint32_t i = 0; i < 16; i++)
+    pool::Delete(node_pool.New(ReleaseNode{i}));
+  size_t released_chunks = node_pool.GetNumOfChunks();
+  std::cout << "Chunks: " << chunks << " -> " << released_chunks << "\n";
+
+  return (chunks == 3 && released_chunks == 2) ? 0 : 1;
+}
+
+int test5() {
+  std::cout << "\nTest" << ++test_count
+            << ": Batch allocation spans pools and reuses freed blocks\n";
+
+  struct BatchNode {
+    BatchNode(uint32_t p_num) : num(p_num) {}
+    uint32_t num;
+  };
+  auto &node_pool = Pool<BatchNode>::Instance();
+
+  // 2 + 4 + 8 + 16 blocks
+  std::vector<BatchNode *> nodes(20);
+  pool::NewBatch<BatchNode>(nodes, 7u);
+  std::cout << "Chunks: " << node_pool.GetNumOfChunks() << "\n";
+  if (node_pool.GetNumOfChunks() != 4)
+    return 1;
+
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i]->num != 7)
+      return 1;
+    for (size_t j = 0; j < i; j++) {
+      if (nodes[i] == nodes[j])
+        return 1;
+    }
+  }
+
+  BatchNode *freed[] = {nodes[17], nodes[18], nodes[19]};
+  for (auto node : freed)
+    pool::Delete(node);
+
+  std::vector<BatchNode *> reused(3);
+  node_pool.NewBatch(reused, 8u);
+  for (auto node : reused) {
+    if (node->num != 8 ||
+        std::find(std::begin(freed), std::end(freed), node) == std::end(freed))
+      return 1;
+  }
+
+  node_pool.Clear();
+  return 0;
+}
+
+struct BatchObj {
+  BatchObj(uint32_t p_num) : num(p_num) {}
+  ~BatchObj() { destroyed++; }
+  static inline std::atomic<size_t> destroyed = 0;
+  uint32_t num;
+};
+
+int test6() {
+  std::cout << "\nTest" << ++test_count
+            << ": Batch deleting local objects and objects moved from "
+               "another thread\n";
+
+  // Fills the 2 + 4 blocks pools.
+  std::vector<BatchObj *> moved(6);
+  pool::NewBatch<BatchObj>(moved, 1u);
+
+  std::thread t1(
+      +[](std::vector<BatchObj *> *moved_objs) {
+        std::vector<BatchObj *> objs(3);
+        pool::NewBatch<BatchObj>(objs, 2u);
+        objs.insert(objs.begin() + 1, moved_objs->begin(), moved_objs->end());
+        pool::DeleteBatch<BatchObj>(objs);
+      },
+      &moved);
+  t1.join();
+
+  if (BatchObj::destroyed != 9)
+    return 1;
+
+  std::vector<BatchObj *> reused(6);
+  pool::NewBatch<BatchObj>(reused, 3u);
+  for (auto obj : reused) {
+    if (std::find(moved.begin(), moved.end(), obj) == moved.end())
+      return 1;
+  }
+
+  return 0;
+}
+
+struct UniqueObj {
+  static inline std::atomic<size_t> destroyed = 0;
+  UniqueObj(uint32_t p_num) : num(p_num) {}
+  ~UniqueObj() { destroyed++; }
+  uint32_t num;
+};
+
+int test7() {
+  std::cout << "\nTest" << ++test_count
+            << ": pool::unique_ptr deleting locally and from another "
+               "thread\n";
+
+  std::vector<pool::unique_ptr<UniqueObj>> objs;
+  for (uint32_t i = 0; i < 4; i++)
+    objs.push_back(pool::make_unique<UniqueObj>(i));
+  UniqueObj *first = objs[0].get();
+  UniqueObj *last = objs[3].get();
+
+  objs[0].reset();
+  if (UniqueObj::destroyed != 1)
+    return 1;
+
+  // The other thread drops the rest, they come back through the chunks.
+  std::thread t1(
+      +[](std::vector<pool::unique_ptr<UniqueObj>> moved_objs) {
+        moved_objs.clear();
+      },
+      std::move(objs));
+  t1.join();
+  if (UniqueObj::destroyed != 4)
+    return 1;
+
+  std::vector<pool::unique_ptr<UniqueObj>> reused;
+  for (uint32_t i = 0; i < 4; i++)
+    reused.push_back(pool::make_unique<UniqueObj>(i));
+  bool found_first = false, found_last = false;
+  for (auto &obj : reused) {
+    found_first |= obj.get() == first;
+    found_last |= obj.get() == last;
+  }
+
+  return found_first && found_last ? 0 : 1;
+}
+
+struct SharedMsg {
+  static inline std::atomic<size_t> destroyed = 0;
+  SharedMsg(uint32_t p_num) : num(p_num) {}
+  ~SharedMsg() { destroyed++; }
+  uint32_t num;
+};
+
+int test8() {
+  std::cout << "\nTest" << ++test_count
+            << ": pool::make_shared released last on another thread\n";
+
+  std::shared_ptr<SharedMsg> msg = pool::make_shared<SharedMsg>(7u);
+  SharedMsg *first = msg.get();
+
+  std::thread t1(
+      +[](std::shared_ptr<SharedMsg> *moved_msg) {
+        std::shared_ptr<SharedMsg> copy = *moved_msg;
+        moved_msg->reset();
+        if (copy->num != 7)
+          std::abort();
+      },
+      &msg);
+  t1.join();
+  if (SharedMsg::destroyed != 1)
+    return 1;
+
+  // The object and its counts were one block, it is back with its owner.
+  std::vector<std::shared_ptr<SharedMsg>> msgs;
+  bool reused = false;
+  for (uint32_t i = 0; i < 64 && !reused; i++) {
+    msgs.push_back(pool::make_shared<SharedMsg>(i));
+    reused = msgs.back().get() == first;
+  }
+
+  return reused ? 0 : 1;
+}
+
+struct NumaObj {
+  uint64_t num;
+};
+
+static thread_local int fake_numa_node = 0;
+
+// Runs on `node` and allocates, then on `nested_node` from a second thread
+// while the first one still holds its state. Returns where they allocated.
+static void RunOnNodes(int node, int nested_node, NumaObj **out,
+                       NumaObj **nested_out) {
+  std::thread t(
+      +[](int n, int nested_n, NumaObj **o, NumaObj **nested_o) {
+        fake_numa_node = n;
+        *o = pool::New<NumaObj>(NumaObj{(uint64_t)n});
+        pool::Delete(*o);
+        if (nested_n < 0)
+          return;
+        std::thread nested(
+            +[](int n, NumaObj **o) {
+              fake_numa_node = n;
+              *o = pool::New<NumaObj>(NumaObj{(uint64_t)n});
+              pool::Delete(*o);
+            },
+            nested_n, nested_o);
+        nested.join();
+      },
+      node, nested_node, out, nested_out);
+  t.join();
+}
+
+int test9() {
+  std::cout << "\nTest" << ++test_count
+            << ": Orphaned pools are reused by threads on the same NUMA "
+               "node first\n";
+
+  // One state per node, both orphaned.
+  NumaObj *on_node1 = nullptr;
+  NumaObj *on_node0 = nullptr;
+  RunOnNodes(1, 0, &on_node1, &on_node0);
+  // Each node picks its own one although the other one is free too.
+  NumaObj *on_node0_again = nullptr;
+  NumaObj *on_node1_again = nullptr;
+  RunOnNodes(0, -1, &on_node0_again, nullptr);
+  RunOnNodes(1, -1, &on_node1_again, nullptr);
+  // Node 0's state is taken, the second node 0 thread falls back to node 1's
+  // one instead of creating a third state.
+  NumaObj *busy = nullptr;
+  NumaObj *fallback = nullptr;
+  RunOnNodes(0, 0, &busy, &fallback);
+
+  std::cout << "States: " << pool::Stats<NumaObj>().states << "\n";
+  if (on_node0 == on_node1 || on_node0_again != on_node0 ||
+      on_node1_again != on_node1 || busy != on_node0 ||
+      fallback != on_node1 || pool::Stats<NumaObj>().states != 2)
+    return 1;
+  return 0;
+}
+
+struct RemoteObj {
+  uint64_t num;
+};
+
+int test10() {
+  std::cout << "\nTest" << ++test_count
+            << ": Buffered remote deletes reach the owner once flushed\n";
+
+  std::vector<RemoteObj *> objs;
+  for (uint64_t i = 0; i < 8; i++)
+    objs.push_back(pool::New<RemoteObj>(RemoteObj{i}));
+
+  std::atomic<bool> deleted = false;
+  std::atomic<bool> checked = false;
+  // Stays alive while the owner allocates again, so only the explicit flush
+  // can have handed the deletes over.
+  std::thread t([&] {
+    for (RemoteObj *obj : objs)
+      pool::Delete(obj);
+    pool::FlushRemoteFrees<RemoteObj>();
+    deleted = true;
+    while (!checked)
+      std::this_thread::yield();
+  });
+  while (!deleted)
+    std::this_thread::yield();
+
+  std::vector<RemoteObj *> again;
+  for (uint64_t i = 0; i < 64; i++)
+    again.push_back(pool::New<RemoteObj>(RemoteObj{i}));
+  checked = true;
+  t.join();
+
+  size_t reused = 0;
+  for (RemoteObj *obj : objs)
+    reused += std::find(again.begin(), again.end(), obj) != again.end();
+  for (RemoteObj *obj : again)
+    pool::Delete(obj);
+
+  return reused == objs.size() ? 0 : 1;
+}
+
+struct TinyObj {
+  uint32_t num;
+};
+
+// Keeps its chunks, so the chunk count tells whether the frees came back.
+template <> struct PoolTraits<TinyObj> : DefaultPoolTraits {
+  static constexpr uint32_t kDepotChunks = 0;
+};
+
+int test11() {
+  std::cout << "\nTest" << ++test_count
+            << ": Two threads push 4 byte blocks to the same chunks\n";
+
+  // Tiny blocks only have room for a block index, the chains go through it.
+  std::vector<TinyObj *> objs;
+  for (uint32_t i = 0; i < 4096; i++)
+    objs.push_back(pool::New<TinyObj>(TinyObj{i}));
+  std::vector<TinyObj *> shuffled = objs;
+  std::reverse(shuffled.begin() + 2048, shuffled.end());
+
+  auto free_half = +[](TinyObj **begin, size_t n, bool batch) {
+    if (batch) {
+      pool::DeleteBatch(std::span<TinyObj *>(begin, n));
+      return;
+    }
+    for (size_t i = 0; i < n; i++)
+      pool::Delete(begin[i]);
+  };
+  std::thread t1(free_half, shuffled.data(), (size_t)2048, false);
+  std::thread t2(free_half, shuffled.data() + 2048, (size_t)2048, true);
+  t1.join();
+  t2.join();
+
+  // Every block came back, refilling them needs no new chunk.
+  size_t chunks = Pool<TinyObj>::Instance().GetNumOfChunks();
+  std::vector<TinyObj *> again;
+  for (uint32_t i = 0; i < 4096; i++)
+    again.push_back(pool::New<TinyObj>(TinyObj{i}));
+  bool grew = Pool<TinyObj>::Instance().GetNumOfChunks() != chunks;
+  for (TinyObj *obj : again)
+    pool::Delete(obj);
+
+  return grew ? 1 : 0;
+}
+
+struct ReclaimObj {
+  uint64_t num;
+};
+
+int test12() {
+  std::cout << "\nTest" << ++test_count
+            << ": Frees into an exited thread's pool release its chunks\n";
+
+  // Gets a state of its own first, otherwise it'd adopt the exited thread's.
+  (void)Pool<ReclaimObj>::Instance();
+
+  std::vector<ReclaimObj *> objs;
+  std::thread t1(
+      +[](std::vector<ReclaimObj *> *out) {
+        for (uint64_t i = 0; i < 200; i++)
+          out->push_back(pool::New<ReclaimObj>(ReclaimObj{i}));
+      },
+      &objs);
+  t1.join();
+
+  // The owner is gone, deleting reclaims its state right away.
+  for (ReclaimObj *obj : objs)
+    pool::Delete(obj);
+  pool::FlushRemoteFrees<ReclaimObj>();
+
+  // Adopts the state, only the active chunk was kept.
+  size_t chunks = 0;
+  std::thread t2(
+      +[](size_t *out) {
+        *out = Pool<ReclaimObj>::Instance().GetNumOfChunks();
+      },
+      &chunks);
+  t2.join();
+
+  return chunks == 1 ? 0 : 1;
+}
+
+struct DepotObj {
+  uint64_t num;
+};
+
+template <> struct PoolTraits<DepotObj> : DefaultPoolTraits {
+  static constexpr uint32_t kReleaseInterval = 8;
+};
+
+int test13() {
+  std::cout << "\nTest" << ++test_count
+            << ": A growing thread adopts the chunks another one emptied\n";
+
+  (void)Pool<DepotObj>::Instance();
+
+  std::vector<DepotObj *> freed;
+  size_t idle_chunks = 0;
+  size_t kept_chunks = 0;
+  std::atomic<bool> emptied = false;
+  std::atomic<bool> grown = false;
+  // Stays alive, its chunks can only have moved through the depot.
+  std::thread t([&] {
+    for (uint64_t i = 0; i < 64; i++)
+      freed.push_back(pool::New<DepotObj>(DepotObj{i}));
+    for (DepotObj *obj : freed)
+      pool::Delete(obj);
+    idle_chunks = Pool<DepotObj>::Instance().GetNumOfChunks();
+    // Donated once a second release check in a row finds them unused.
+    for (uint64_t i = 0; i < PoolTraits<DepotObj>::kReleaseInterval; i++)
+      pool::Delete(pool::New<DepotObj>(DepotObj{i}));
+    kept_chunks = Pool<DepotObj>::Instance().GetNumOfChunks();
+    emptied = true;
+    while (!grown)
+      std::this_thread::yield();
+  });
+  while (!emptied)
+    std::this_thread::yield();
+
+  std::vector<DepotObj *> objs;
+  for (uint64_t i = 0; i < 64; i++)
+    objs.push_back(pool::New<DepotObj>(DepotObj{i}));
+  grown = true;
+  t.join();
+
+  size_t adopted = 0;
+  for (DepotObj *obj : objs)
+    adopted += std::find(freed.begin(), freed.end(), obj) != freed.end();
+  for (DepotObj *obj : objs)
+    pool::Delete(obj);
+
+  std::cout << "Chunks idle: " << idle_chunks << ", kept: " << kept_chunks
+            << ", blocks adopted: " << adopted << "\n";
+  return idle_chunks > kept_chunks && kept_chunks == 2 && adopted > 0
+             ? 0
+             : 1;
+}
+
+struct MagObj {
+  uint64_t num;
+};
+
+template <> struct PoolTraits<MagObj> : DefaultPoolTraits {
+  static constexpr uint32_t kMagazineSize = 4;
+};
+
+int test14() {
+  std::cout << "\nTest" << ++test_count
+            << ": Magazines reuse blocks on the thread which freed them\n";
+
+  std::vector<MagObj *> objs;
+  for (uint64_t i = 0; i < 16; i++)
+    objs.push_back(pool::New<MagObj>(MagObj{i}));
+  size_t chunks = Pool<MagObj>::Instance().GetNumOfChunks();
+
+  auto was_freed = [&objs](const std::vector<MagObj *> &again) {
+    for (MagObj *obj : again) {
+      if (std::find(objs.begin(), objs.end(), obj) == objs.end())
+        return false;
+    }
+    return true;
+  };
+
+  // Frees 16, keeps two magazines and sends the other two to the depot.
+  std::vector<MagObj *> reused;
+  std::thread t(
+      +[](std::vector<MagObj *> *moved, std::vector<MagObj *> *out) {
+        for (MagObj *obj : *moved)
+          pool::Delete(obj);
+        for (uint64_t i = 0; i < 8; i++)
+          out->push_back(pool::New<MagObj>(MagObj{i}));
+      },
+      &objs, &reused);
+  t.join();
+  if (!was_freed(reused))
+    return 1;
+
+  // The full magazines in the depot, not a new chunk.
+  std::vector<MagObj *> from_depot;
+  for (uint64_t i = 0; i < 8; i++)
+    from_depot.push_back(pool::New<MagObj>(MagObj{i}));
+  if (!was_freed(from_depot) ||
+      Pool<MagObj>::Instance().GetNumOfChunks() != chunks)
+    return 1;
+
+  for (MagObj *obj : reused)
+    pool::Delete(obj);
+  for (MagObj *obj : from_depot)
+    pool::Delete(obj);
+
+  // The exited thread's counters are still summed.
+  PoolStats stats = pool::Stats<MagObj>();
+  std::cout << "News: " << stats.news << ", live: " << stats.live << "\n";
+  return stats.news == 32 && stats.deletes == 32 && stats.live == 0 &&
+                 stats.chunks == chunks
+             ? 0
+             : 1;
+}
+
+struct ClearObj {
+  static inline std::atomic<size_t> destroyed = 0;
+  ClearObj(uint64_t p_num) : num(p_num) {}
+  ~ClearObj() { destroyed++; }
+  uint64_t num;
+};
+
+int test15() {
+  std::cout << "\nTest" << ++test_count
+            << ": Clear after another thread flushed its deletes\n";
+
+  std::vector<ClearObj *> objs;
+  for (uint64_t i = 0; i < 8; i++)
+    objs.push_back(pool::New<ClearObj>(i));
+  ClearObj::destroyed = 0;
+
+  std::atomic<bool> flushed = false;
+  std::atomic<bool> cleared = false;
+  // Stays alive, `Clear` only relies on the flush.
+  std::thread t([&] {
+    for (size_t i = 0; i < 4; i++)
+      pool::Delete(objs[i]);
+    pool::FlushRemoteFrees<ClearObj>();
+    flushed = true;
+    while (!cleared)
+      std::this_thread::yield();
+  });
+  while (!flushed)
+    std::this_thread::yield();
+
+  Pool<ClearObj>::Instance().Clear();
+  size_t destroyed = ClearObj::destroyed;
+  uint64_t live = pool::Stats<ClearObj>().live;
+  cleared = true;
+  t.join();
+
+  // Every block is free exactly once, none is handed out twice.
+  std::vector<ClearObj *> again;
+  for (uint64_t i = 0; i < 64; i++)
+    again.push_back(pool::New<ClearObj>(i));
+  std::vector<ClearObj *> sorted = again;
+  std::sort(sorted.begin(), sorted.end());
+  bool unique =
+      std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+  for (ClearObj *obj : again)
+    pool::Delete(obj);
+  std::cout << "Destroyed: " << destroyed << ", live: " << live
+            << ", unique: " << unique << "\n";
+  return destroyed == 8 && live == 0 && unique &&
+                 pool::Stats<ClearObj>().live == 0
+             ? 0
+             : 1;
+}
+
 int main() {
 #define defer_return(v)                                                        \
   do {                                                                         \
@@ -118,10 +695,40 @@ int main() {
 
   int result = 0;
 
+  // Two nodes for test9, set before any pool is used. Threads stay on node 0
+  // unless a test moves them.
+  NumaTopology::SetProvider(+[] { return fake_numa_node; }, 2);
+
   if (test1() != 0)
     defer_return(1);
   if (test2() != 0)
     defer_return(1);
+  if (test3() != 0)
+    defer_return(1);
+  if (test4() != 0)
+    defer_return(1);
+  if (test5() != 0)
+    defer_return(1);
+  if (test6() != 0)
+    defer_return(1);
+  if (test7() != 0)
+    defer_return(1);
+  if (test8() != 0)
+    defer_return(1);
+  if (test9() != 0)
+    defer_return(1);
+  if (test10() != 0)
+    defer_return(1);
+  if (test11() != 0)
+    defer_return(1);
+  if (test12() != 0)
+    defer_return(1);
+  if (test13() != 0)
+    defer_return(1);
+  if (test14() != 0)
+    defer_return(1);
+  if (test15() != 0)
+    defer_return(1);
 
   printf("\nAll %d Tests passed\n", test_count);
 defer:
@@ -0,0 +1,97 @@
+// Tests of the `MEMORY_POOL_TRACE` build, kept apart so the other tests run
+// with tracing compiled out.
+#define FIXED_POOL_BLOCK_COUNT 2
+#define MEMORY_POOL_TRACE 1
+
+#include "memory_pool.h"
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+static int test_count = 0;
+
+struct TraceObj {
+  uint64_t num;
+};
+
+int test1() {
+  std::cout << "\nTest" << ++test_count
+            << ": Trace events survive a write and read back\n";
+
+  pool::EventTrace::Clear();
+  std::vector<TraceObj *> objs;
+  for (uint64_t i = 0; i < 8; i++)
+    objs.push_back(pool::New<TraceObj>(TraceObj{i}));
+  for (size_t i = 0; i < 4; i++)
+    pool::Delete(objs[i]);
+  std::thread t(
+      +[](TraceObj **moved) {
+        for (size_t i = 0; i < 4; i++)
+          pool::Delete(moved[i]);
+        pool::FlushRemoteFrees<TraceObj>();
+      },
+      objs.data() + 4);
+  t.join();
+  // Runs out of blocks and collects the remote deletes.
+  for (uint64_t i = 0; i < 8; i++)
+    objs[i] = pool::New<TraceObj>(TraceObj{i});
+  for (TraceObj *obj : objs)
+    pool::Delete(obj);
+
+  std::stringstream file;
+  pool::EventTrace::Write(file);
+  pool::TraceFile trace;
+  if (!pool::EventTrace::Read(file, trace))
+    return 1;
+
+  uint32_t type = 0;
+  for (const pool::TraceFile::Type &t : trace.types) {
+    if (t.name == "TraceObj" && t.size == sizeof(TraceObj))
+      type = t.id;
+  }
+  size_t counts[4] = {};
+  size_t remote = 0;
+  for (const pool::TraceFile::Thread &thread : trace.threads) {
+    for (const pool::TraceEvent &event : thread.events) {
+      if (event.type != type)
+        continue;
+      counts[(size_t)event.kind]++;
+      remote += (event.flags & pool::kTraceRemote) != 0;
+    }
+  }
+  std::cout << "News: " << counts[0] << ", deletes: " << counts[1]
+            << ", remote: " << remote << ", collects: " << counts[2]
+            << ", chunks: " << counts[3] << "\n";
+  if (type == 0 || counts[0] != 16 || counts[1] != 16 || remote != 4 ||
+      counts[2] == 0 || counts[3] == 0)
+    return 1;
+
+  std::stringstream json;
+  pool::EventTrace::WriteChromeJson(trace, json);
+  std::string text = json.str();
+  return text.find("\"traceEvents\"") != std::string::npos &&
+                 text.find("live TraceObj") != std::string::npos
+             ? 0
+             : 1;
+}
+
+int main() {
+#define defer_return(v)                                                        \
+  do {                                                                         \
+    result = (v);                                                              \
+    goto defer;                                                                \
+  } while (0)
+
+  int result = 0;
+
+  if (test1() != 0)
+    defer_return(1);
+
+  printf("\nAll %d Tests passed\n", test_count);
+defer:
+  if (result != 0) {
+    printf("\n%d Tests passed, some other test failed\n", test_count - 1);
+  }
+  return result;
+}